@@ -0,0 +1,31 @@
+/*
+	The hash behind the table of asset ids, shared by idtable and the game.
+
+	Every asset path is given an id, and ids are numbered so that a path's
+	id can be found from its hash without any searching: the path's hash
+	with seed 0 picks one of ASSET_BUCKETS buckets, and that bucket's
+	displacement is the seed for a second hash, which is the id. This is
+	"hash and displace" perfect hashing; idtable searches for displacements
+	which give every path its own id.
+*/
+#ifndef QS_ASSETID_H
+#define QS_ASSETID_H
+
+#include <stdint.h>
+
+// FNV-1a hash of a path, with the basis varied by seed, and mixed so that
+// the low bits are usable.
+static inline uint32_t asset_hash(const char *path, uint32_t seed){
+	uint32_t h = 2166136261u ^ (seed * 0x9e3779b9u);
+
+	while(*path)
+		h = (h ^ (uint8_t) *(path++)) * 16777619u;
+
+	h ^= h >> 15;
+	h *= 0x2c1b3c6du;
+	h ^= h >> 12;
+
+	return h;
+}
+
+#endif
@@ -0,0 +1,321 @@
+/*
+	atlaspack.c
+	mperron (2020)
+
+	Packs small bitmaps into atlas pages, so that everything drawn from them
+	shares a texture. Usage:
+
+		atlaspack <table> <page prefix> <name prefix> [image.bmp...]
+
+	Each page is written out as a 24-bit BMP named <page prefix>N.bmp, with
+	the space around images filled with magenta so it's transparent once
+	color keyed. The table is C++ source listing every image's page and
+	rectangle, with <name prefix> taken off the front of image paths.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#define ATLAS_PAGE_SIZE 1024
+#define ATLAS_PADDING 1
+
+typedef struct {
+	const char *path;
+	int w, h;
+	uint8_t *bgr;
+
+	int page, x, y;
+} image;
+
+static uint32_t le32(const uint8_t *p){
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t) p[3] << 24);
+}
+
+static uint16_t le16(const uint8_t *p){
+	return p[0] | (p[1] << 8);
+}
+
+static int mask_shift(uint32_t mask){
+	int shift = 0;
+
+	if(!mask)
+		return 0;
+
+	while(!(mask & 1)){
+		mask >>= 1;
+		shift++;
+	}
+
+	return shift;
+}
+
+// Read an uncompressed BMP of 1, 4, 8, 24 or 32 bits into 24-bit BGR rows,
+// top row first. Returns 0 on success.
+static int bmp_read(image *img){
+	FILE *f = fopen(img->path, "rb");
+	uint8_t *data = NULL;
+	long n;
+
+	if(!f){
+		fprintf(stderr, "File not found: %s\n", img->path);
+		return 1;
+	}
+
+	fseek(f, 0, SEEK_END);
+	n = ftell(f);
+	fseek(f, 0, SEEK_SET);
+
+	if((n < 54) || !(data = malloc(n)) || (fread(data, 1, n, f) != (size_t) n)){
+		fprintf(stderr, "Failed to read %s\n", img->path);
+		fclose(f);
+		free(data);
+		return 1;
+	}
+	fclose(f);
+
+	uint32_t offset = le32(data + 10), header = le32(data + 14);
+	int32_t w = (int32_t) le32(data + 18), h = (int32_t) le32(data + 22);
+	int bpp = le16(data + 28);
+	uint32_t compression = le32(data + 30), colors = le32(data + 46);
+	uint32_t masks[3] = { 0xff0000, 0xff00, 0xff };
+	int top_down = (h < 0);
+
+	if(h < 0)
+		h = -h;
+
+	// Bit fields follow a 40 byte header, or are part of a bigger one.
+	if(compression == 3){
+		if(14 + 40 + 12 > n){
+			free(data);
+			return 1;
+		}
+
+		masks[0] = le32(data + 54);
+		masks[1] = le32(data + 58);
+		masks[2] = le32(data + 62);
+	}
+
+	if(
+		memcmp(data, "BM", 2) || (w <= 0) || (h <= 0) ||
+		((compression != 0) && !((compression == 3) && (bpp == 32))) ||
+		((bpp != 1) && (bpp != 4) && (bpp != 8) && (bpp != 24) && (bpp != 32))
+	){
+		fprintf(stderr, "Unsupported bitmap: %s\n", img->path);
+		free(data);
+		return 1;
+	}
+
+	size_t stride = ((size_t) w * bpp + 31) / 32 * 4;
+	const uint8_t *palette = data + 14 + header;
+
+	if(!colors)
+		colors = 1 << ((bpp <= 8) ? bpp : 0);
+
+	if((offset + stride * h > (size_t) n) || ((bpp <= 8) && (14 + header + colors * 4 > (size_t) n))){
+		fprintf(stderr, "Truncated bitmap: %s\n", img->path);
+		free(data);
+		return 1;
+	}
+
+	img->w = w;
+	img->h = h;
+	img->bgr = malloc((size_t) w * h * 3);
+
+	for(int y = 0; y < h; y++){
+		const uint8_t *row = data + offset + stride * (top_down ? y : (h - 1 - y));
+		uint8_t *out = img->bgr + (size_t) y * w * 3;
+
+		for(int x = 0; x < w; x++, out += 3){
+			if(bpp <= 8){
+				int per_byte = 8 / bpp;
+				int ix = (row[x / per_byte] >> ((per_byte - 1 - x % per_byte) * bpp)) & ((1 << bpp) - 1);
+
+				if((uint32_t) ix >= colors)
+					ix = 0;
+
+				memcpy(out, palette + ix * 4, 3);
+			} else if(bpp == 24){
+				memcpy(out, row + x * 3, 3);
+			} else {
+				uint32_t px = le32(row + x * 4);
+
+				out[0] = (px & masks[2]) >> mask_shift(masks[2]);
+				out[1] = (px & masks[1]) >> mask_shift(masks[1]);
+				out[2] = (px & masks[0]) >> mask_shift(masks[0]);
+			}
+		}
+	}
+
+	free(data);
+	return 0;
+}
+
+static void put32(uint8_t *p, uint32_t v){
+	p[0] = v;
+	p[1] = v >> 8;
+	p[2] = v >> 16;
+	p[3] = v >> 24;
+}
+
+static int bmp_write(const char *path, const uint8_t *bgr, int w, int h){
+	size_t stride = ((size_t) w * 3 + 3) / 4 * 4;
+	uint8_t header[54] = { 'B', 'M' };
+	uint8_t pad[3] = { 0, 0, 0 };
+	FILE *f = fopen(path, "wb");
+
+	if(!f){
+		fprintf(stderr, "Failed to open %s for writing!\n", path);
+		return 1;
+	}
+
+	put32(header + 2, 54 + stride * h);
+	put32(header + 10, 54);
+	put32(header + 14, 40);
+	put32(header + 18, w);
+	put32(header + 22, h);
+	header[26] = 1;
+	header[28] = 24;
+	put32(header + 34, stride * h);
+
+	fwrite(header, 1, sizeof(header), f);
+
+	for(int y = h - 1; y >= 0; y--){
+		fwrite(bgr + (size_t) y * w * 3, 1, (size_t) w * 3, f);
+		fwrite(pad, 1, stride - (size_t) w * 3, f);
+	}
+
+	return fclose(f);
+}
+
+static int by_height(const void *a, const void *b){
+	const image *ia = *(image* const*) a, *ib = *(image* const*) b;
+
+	if(ia->h != ib->h)
+		return ib->h - ia->h;
+
+	return strcmp(ia->path, ib->path);
+}
+
+int main(int argc, char **argv){
+	if(argc < 4){
+		fprintf(stderr, "Usage:\n\t%s <table> <page prefix> <name prefix> [image.bmp...]\n", *argv);
+		return 0;
+	}
+
+	const char *table_path = argv[1], *page_prefix = argv[2], *name_prefix = argv[3];
+	int count = argc - 4, pages = 0;
+	image *images = calloc(count + 1, sizeof(image));
+	image **order = calloc(count + 1, sizeof(image*));
+
+	for(int i = 0; i < count; i++){
+		images[i].path = argv[i + 4];
+		order[i] = &images[i];
+
+		if(bmp_read(&images[i]))
+			return 1;
+
+		if((images[i].w + 2 * ATLAS_PADDING > ATLAS_PAGE_SIZE) || (images[i].h + 2 * ATLAS_PADDING > ATLAS_PAGE_SIZE)){
+			fprintf(stderr, "Too big for an atlas: %s\n", images[i].path);
+			return 1;
+		}
+	}
+
+	// Tallest first onto shelves, starting a new page when one fills up.
+	qsort(order, count, sizeof(image*), by_height);
+
+	{
+		int x = ATLAS_PADDING, y = ATLAS_PADDING, shelf = 0;
+
+		for(int i = 0; i < count; i++){
+			image *img = order[i];
+
+			if(x + img->w + ATLAS_PADDING > ATLAS_PAGE_SIZE){
+				x = ATLAS_PADDING;
+				y += shelf + ATLAS_PADDING;
+				shelf = 0;
+			}
+
+			if(y + img->h + ATLAS_PADDING > ATLAS_PAGE_SIZE){
+				x = y = ATLAS_PADDING;
+				shelf = 0;
+				pages++;
+			}
+
+			img->page = pages;
+			img->x = x;
+			img->y = y;
+
+			x += img->w + ATLAS_PADDING;
+			if(img->h > shelf)
+				shelf = img->h;
+		}
+
+		if(count)
+			pages++;
+	}
+
+	// Each page is cropped to what's used on it.
+	for(int p = 0; p < pages; p++){
+		int w = 1, h = 1;
+		char path[4096];
+
+		for(int i = 0; i < count; i++){
+			if(images[i].page != p)
+				continue;
+
+			if(images[i].x + images[i].w + ATLAS_PADDING > w)
+				w = images[i].x + images[i].w + ATLAS_PADDING;
+			if(images[i].y + images[i].h + ATLAS_PADDING > h)
+				h = images[i].y + images[i].h + ATLAS_PADDING;
+		}
+
+		uint8_t *bgr = malloc((size_t) w * h * 3);
+
+		for(size_t k = 0; k < (size_t) w * h; k++){
+			bgr[k * 3 + 0] = 0xff;
+			bgr[k * 3 + 1] = 0x00;
+			bgr[k * 3 + 2] = 0xff;
+		}
+
+		for(int i = 0; i < count; i++)
+			if(images[i].page == p)
+				for(int y = 0; y < images[i].h; y++)
+					memcpy(
+						bgr + ((size_t)(images[i].y + y) * w + images[i].x) * 3,
+						images[i].bgr + (size_t) y * images[i].w * 3,
+						(size_t) images[i].w * 3
+					);
+
+		snprintf(path, sizeof(path), "%s%d.bmp", page_prefix, p);
+
+		if(bmp_write(path, bgr, w, h))
+			return 1;
+
+		free(bgr);
+	}
+
+	FILE *table = fopen(table_path, "w");
+
+	if(!table){
+		fprintf(stderr, "Failed to open %s for writing!\n", table_path);
+		return 1;
+	}
+
+	fprintf(table, "/*\n\tAuto-generated atlas table.\n*/\n");
+	fprintf(table, "const AtlasRegion atlas_regions[] = {\n");
+
+	for(int i = 0; i < count; i++){
+		const char *name = images[i].path;
+
+		if(!strncmp(name, name_prefix, strlen(name_prefix)))
+			name += strlen(name_prefix);
+
+		fprintf(table, "\t{ \"%s\", %d, { %d, %d, %d, %d } },\n", name, images[i].page, images[i].x, images[i].y, images[i].w, images[i].h);
+	}
+
+	fprintf(table, "\t{ NULL, 0, { 0, 0, 0, 0 } }\n};\n");
+
+	return fclose(table);
+}
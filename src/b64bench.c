@@ -0,0 +1,103 @@
+/*
+	b64bench.c
+	mperron (2020)
+
+	Measures base64 encoding and decoding throughput, with whatever SIMD
+	the CPU has and with the plain scalar code, over a buffer of random
+	bytes. Usage:
+
+		b64bench [megabytes]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "base64.h"
+
+#define BENCH_ROUNDS 5
+
+// Keep the fastest time seen for a test, in seconds.
+static void keep_best(double *best, clock_t start){
+	double t = (double)(clock() - start) / CLOCKS_PER_SEC;
+
+	if(t < *best)
+		*best = t;
+}
+
+// Report the best of the rounds, in megabytes of decoded data per second.
+static void report(const char *name, size_t n, double best){
+	printf("%-16s %8.1f MB/s\n", name, n / best / (1024 * 1024));
+}
+
+int main(int argc, char **argv){
+	size_t n = ((argc > 1) ? (size_t) atoi(argv[1]) : 64) * 1024 * 1024;
+	size_t len = (n + 2) / 3 * 4;
+	unsigned char *data = malloc(n);
+	char *enc = malloc(len + 1), *dec = malloc(n), *scratch = malloc(len + 1);
+	double best[5] = { 1e9, 1e9, 1e9, 1e9, 1e9 };
+
+	if(!data || !enc || !dec || !scratch){
+		fprintf(stderr, "Failed to allocate %zu bytes!\n", n);
+		return 2;
+	}
+
+	srand(time(NULL));
+	for(size_t i = 0; i < n; i++)
+		data[i] = rand();
+
+	for(int round = 0; round < BENCH_ROUNDS; round++){
+		clock_t start = clock();
+		char *e = base64_enc(data, n);
+
+		keep_best(&best[0], start);
+
+		start = clock();
+		base64_enc_scalar(data, n, enc);
+		keep_best(&best[1], start);
+
+		if(memcmp(e, enc, len)){
+			fprintf(stderr, "Encoders disagree!\n");
+			return 1;
+		}
+		free(e);
+
+		start = clock();
+		base64_dec_into(enc, len, dec, n);
+		keep_best(&best[2], start);
+
+		if(memcmp(dec, data, n)){
+			fprintf(stderr, "Decoding failed!\n");
+			return 1;
+		}
+
+		start = clock();
+		base64_dec_scalar(enc, len, dec, n);
+		keep_best(&best[3], start);
+
+		memcpy(scratch, enc, len);
+		start = clock();
+		base64_dec_into(scratch, len, scratch, n);
+		keep_best(&best[4], start);
+
+		if(memcmp(scratch, data, n)){
+			fprintf(stderr, "Decoding in place failed!\n");
+			return 1;
+		}
+	}
+
+	printf("%zu MB, best of %d\n", n / (1024 * 1024), BENCH_ROUNDS);
+	report("encode", n, best[0]);
+	report("encode scalar", n, best[1]);
+	report("decode", n, best[2]);
+	report("decode scalar", n, best[3]);
+	report("decode in place", n, best[4]);
+
+	free(data);
+	free(enc);
+	free(dec);
+	free(scratch);
+
+	return 0;
+}
@@ -6,13 +6,23 @@
 	
 	This mechanism requires no lookup table, but produces non-standard base64
 	data.
+
+	On x86, long runs are encoded and decoded 16 or 32 characters at a time
+	with SSSE3 or AVX2, when the CPU has them. The odd characters are fixed
+	up by comparing against each of them, rather than by table lookups.
 */
 #ifndef QS_BASE64_H
 #define QS_BASE64_H
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BASE64_X86
+#include <immintrin.h>
+#endif
+
 static inline char byte_enc(char in){
 	char out = in + 32;
 
@@ -62,31 +72,27 @@ static inline char byte_dec(char in){
 	72-character quoted sections.
 */
 void base64_toquoted(char *data, FILE *stream){
-	int count = 0;
+	size_t len = strlen(data);
 
-	fputc('"', stream);
+	if(!len)
+		fputs("\"\"\n", stream);
 
-	while(*data){
-		fputc(*(data++), stream);
+	for(size_t at = 0; at < len; at += 72){
+		size_t n = ((len - at < 72) ? (len - at) : 72);
 
-		if(++count == 72){
-			fputs("\"\n", stream);
-			count = 0;
-
-			if(*data)
-				fputc('"', stream);
-		}
-	}
-	if(count > 0)
+		fputc('"', stream);
+		fwrite(data + at, sizeof(char), n, stream);
 		fputs("\"\n", stream);
+	}
 }
 
-char *base64_enc(unsigned char *data, size_t len_in){
-	char *data_enc = NULL, *out;
+/*
+	Encodes len_in bytes into out, which must hold 4 * ((len_in + 2) / 3)
+	characters. No terminator is written.
+*/
+static inline void base64_enc_scalar(const unsigned char *data, size_t len_in, char *out){
 	size_t i;
 
-	out = data_enc = ((char*) calloc(4 * ((len_in + 2) / 3) + 1, sizeof(char)));
-
 	for(i = 0; i < len_in;){
 		unsigned long bytes[3] = { 0, 0, 0 }, triple;
 
@@ -99,26 +105,16 @@ char *base64_enc(unsigned char *data, size_t len_in){
 		for(int j = 3; j >= 0; j--)
 			*(out++) = byte_enc((triple >> j * 6) & 0x3f);
 	}
-	*out = 0;
 	while((i-- - len_in) > 0)
 		*(--out) = '~';
-
-	return data_enc;
 }
 
-char *base64_dec(const char *data_const, size_t len_in){
-	char *data_dec = NULL, *out;
-	size_t len_out = len_in / 4 * 3;
-
-	char *data = ((char*) calloc(len_in + 1, sizeof(char))), *data_base;
-	strcpy(data, data_const);
-	data_base = data;
-
-	out = data + len_in;
-	while(*(out--) == '~')
-		len_out--;
-
-	out = data_dec = ((char*) calloc(len_out + 1, sizeof(char)));
+/*
+	Decodes len_in characters, a multiple of four, into out, writing no more
+	than len_out bytes.
+*/
+static inline void base64_dec_scalar(const char *data, size_t len_in, char *out, size_t len_out){
+	char *out_end = out + len_out;
 
 	for(size_t i = 0; i < len_in;){
 		unsigned long bytes[4] = { 0, 0, 0, 0 }, triple;
@@ -131,13 +127,173 @@ char *base64_dec(const char *data_const, size_t len_in){
 			triple += bytes[j] << (3 - j) * 6;
 
 		for(int j = 2; j >= 0; j--)
-			if(out < data_dec + len_out)
+			if(out < out_end)
 				*(out++) = (triple >> j * 8) & 0xff;
 	}
+}
+
+#ifdef BASE64_X86
+// Swap each of the five remapped characters (or values) for the other.
+#define BASE64_FIXUP(set1, cmpeq, band, add, v, c, from, delta) \
+	add(v, band(cmpeq(c, set1((char)(from))), set1((char)(delta))))
+
+// Turn 16 characters into their 6-bit values.
+__attribute__((target("ssse3")))
+static inline __m128i base64_values_ssse3(__m128i c){
+	__m128i v = _mm_sub_epi8(c, _mm_set1_epi8(32));
+
+	v = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, v, c, '{', '"' - '{');
+	v = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, v, c, '|', '?' - '|');
+	v = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, v, c, '}', '\\' - '}');
+	v = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, v, c, 'x', '<' - 'x');
+	v = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, v, c, 'y', '>' - 'y');
+
+	return v;
+}
+
+// Join each four 6-bit values into three bytes, packed into the low twelve.
+__attribute__((target("ssse3")))
+static inline __m128i base64_pack_ssse3(__m128i v){
+	v = _mm_maddubs_epi16(v, _mm_set1_epi32(0x01400140));
+	v = _mm_madd_epi16(v, _mm_set1_epi32(0x00011000));
+
+	return _mm_shuffle_epi8(v, _mm_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+}
+
+// Decode 16 characters at a time, while there are at least 20 left (so the
+// final group, which may be padded, is left over) and room to store 16
+// bytes. Returns the number of characters decoded.
+__attribute__((target("ssse3")))
+static size_t base64_dec_ssse3(const char *data, size_t len_in, char *out, size_t len_out){
+	size_t i = 0;
+
+	for(; (len_in - i >= 20) && (len_out - i / 4 * 3 >= 16); i += 16){
+		__m128i c = _mm_loadu_si128((const __m128i*)(data + i));
+
+		_mm_storeu_si128((__m128i*)(out + i / 4 * 3), base64_pack_ssse3(base64_values_ssse3(c)));
+	}
+
+	return i;
+}
+
+// The same, 32 characters at a time. Each half is packed on its own.
+__attribute__((target("avx2")))
+static size_t base64_dec_avx2(const char *data, size_t len_in, char *out, size_t len_out){
+	size_t i = 0;
+
+	for(; (len_in - i >= 36) && (len_out - i / 4 * 3 >= 28); i += 32){
+		__m256i c = _mm256_loadu_si256((const __m256i*)(data + i));
+		__m256i v = _mm256_sub_epi8(c, _mm256_set1_epi8(32));
+
+		v = BASE64_FIXUP(_mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_add_epi8, v, c, '{', '"' - '{');
+		v = BASE64_FIXUP(_mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_add_epi8, v, c, '|', '?' - '|');
+		v = BASE64_FIXUP(_mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_add_epi8, v, c, '}', '\\' - '}');
+		v = BASE64_FIXUP(_mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_add_epi8, v, c, 'x', '<' - 'x');
+		v = BASE64_FIXUP(_mm256_set1_epi8, _mm256_cmpeq_epi8, _mm256_and_si256, _mm256_add_epi8, v, c, 'y', '>' - 'y');
+
+		v = _mm256_maddubs_epi16(v, _mm256_set1_epi32(0x01400140));
+		v = _mm256_madd_epi16(v, _mm256_set1_epi32(0x00011000));
+		v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+			2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+		));
+
+		char *o = out + i / 4 * 3;
+
+		_mm_storeu_si128((__m128i*) o, _mm256_castsi256_si128(v));
+		_mm_storeu_si128((__m128i*)(o + 12), _mm256_extracti128_si256(v, 1));
+	}
+
+	return i;
+}
+
+// Encode 12 bytes into 16 characters at a time, while 16 bytes can be read.
+// Returns the number of bytes encoded.
+__attribute__((target("ssse3")))
+static size_t base64_enc_ssse3(const unsigned char *data, size_t len_in, char *out){
+	size_t i = 0;
+
+	for(; len_in - i >= 16; i += 12){
+		__m128i in = _mm_loadu_si128((const __m128i*)(data + i));
+
+		// Spread each three bytes across a 32-bit lane, then pull out the
+		// four 6-bit values with shifts done as multiplies.
+		in = _mm_shuffle_epi8(in, _mm_setr_epi8(1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10));
+
+		__m128i hi = _mm_mulhi_epu16(_mm_and_si128(in, _mm_set1_epi32(0x0fc0fc00)), _mm_set1_epi32(0x04000040));
+		__m128i lo = _mm_mullo_epi16(_mm_and_si128(in, _mm_set1_epi32(0x003f03f0)), _mm_set1_epi32(0x01000010));
+		__m128i v = _mm_or_si128(hi, lo);
+		__m128i c = _mm_add_epi8(v, _mm_set1_epi8(32));
+
+		c = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, c, v, 2, '{' - '"');
+		c = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, c, v, 31, '|' - '?');
+		c = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, c, v, 60, '}' - '\\');
+		c = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, c, v, 28, 'x' - '<');
+		c = BASE64_FIXUP(_mm_set1_epi8, _mm_cmpeq_epi8, _mm_and_si128, _mm_add_epi8, c, v, 30, 'y' - '>');
+
+		_mm_storeu_si128((__m128i*)(out + i / 3 * 4), c);
+	}
+
+	return i;
+}
+#endif
+
+char *base64_enc(unsigned char *data, size_t len_in){
+	char *data_enc = ((char*) calloc(4 * ((len_in + 2) / 3) + 1, sizeof(char)));
+	size_t done = 0;
+
+	if(!data_enc)
+		return NULL;
+
+#ifdef BASE64_X86
+	if(__builtin_cpu_supports("ssse3"))
+		done = base64_enc_ssse3(data, len_in, data_enc);
+#endif
+
+	base64_enc_scalar(data + done, len_in - done, data_enc + done / 3 * 4);
+
+	return data_enc;
+}
+
+/*
+	The number of bytes encoded by len_in characters, less padding.
+*/
+size_t base64_dec_len(const char *data, size_t len_in){
+	size_t len_out = len_in / 4 * 3;
+
+	for(size_t i = len_in; (i > 0) && (data[i - 1] == '~'); i--)
+		len_out--;
+
+	return len_out;
+}
+
+/*
+	Decodes len_in characters, a multiple of four, into out, writing no more
+	than len_out bytes. Each group of four characters stands alone, so long
+	data can be decoded in pieces. Output never gets ahead of input, so out
+	may be the same as data, to decode in place.
+*/
+void base64_dec_into(const char *data, size_t len_in, char *out, size_t len_out){
+	size_t done = 0;
+
+#ifdef BASE64_X86
+	if(__builtin_cpu_supports("avx2"))
+		done = base64_dec_avx2(data, len_in, out, len_out);
+
+	if(__builtin_cpu_supports("ssse3"))
+		done += base64_dec_ssse3(data + done, len_in - done, out + done / 4 * 3, len_out - done / 4 * 3);
+#endif
+
+	base64_dec_scalar(data + done, len_in - done, out + done / 4 * 3, len_out - done / 4 * 3);
+}
+
+char *base64_dec(const char *data, size_t len_in){
+	size_t len_out = base64_dec_len(data, len_in);
+	char *data_dec = ((char*) calloc(len_out + 1, sizeof(char)));
 
-	*out = 0;
+	if(data_dec)
+		base64_dec_into(data, len_in, data_dec, len_out);
 
-	free(data_base);
 	return data_dec;
 }
 
@@ -12,7 +12,7 @@ public:
 	enum Suit { A, B, C, D };
 
 private:
-	SDL_Texture *face, *back;
+	TextureRef *face, *back;
 	SDL_Rect draw_region = { 0, 0, PLAYINGCARD_WIDTH, PLAYINGCARD_HEIGHT };
 	enum Suit suit;
 	int value;
@@ -50,7 +50,7 @@ private:
 			}
 
 			if(color != color_last){
-				SDL_SetTextureColorMod(face, color.r, color.g, color.b);
+				face->set_color(color.r, color.g, color.b);
 				color_last = color;
 			}
 		}
@@ -85,15 +85,15 @@ public:
 
 		string face_path = "cards/" + to_string(value) + ".bmp";
 
-		face = textureFromBmp(rend, face_path.c_str(), true);
-		back = textureFromBmp(rend, "cards/back.bmp", true);
+		face = new TextureRef(rend, face_path.c_str(), true);
+		back = new TextureRef(rend, asset::cards_back_bmp, true);
 		set_suit(suit);
 		set_pos(x, y);
 	}
 
 	~PlayingCard(){
-		if(face)
-			SDL_DestroyTexture(face);
+		delete face;
+		delete back;
 	}
 
 	int get_value() const {
@@ -128,11 +128,11 @@ public:
 			draw_region.w, draw_region.h
 		};
 
-		SDL_Texture *face_to_show = (face_up ? face : back);
+		TextureRef *face_to_show = (face_up ? face : back);
 		if(flipping && !flipping_halfway)
 			face_to_show = (face_up ? back: face);
 
-		SDL_RenderCopy(rend, face_to_show, NULL, &draw_offset);
+		face_to_show->copy(rend, NULL, &draw_offset);
 	}
 
 	bool card_flip(){
@@ -2,8 +2,10 @@
 	encoder.c
 	mperron (2019)
 
-	Reads from the file specified in the first argument and writes base64 to
-	stdout in a format that can be #included into C source.
+	Reads from the file specified in the last argument and writes base64 to
+	stdout in a format that can be #included into C source. With -z the data
+	is compressed first (see lz.h), and with -r it's written out as-is
+	rather than base64 encoded.
 */
 
 #include <stdio.h>
@@ -11,44 +13,80 @@
 #include <string.h>
 
 #include "base64.h"
+#include "lz.h"
 
-#define READ_BLOCK_SIZE 256
+#define READ_BLOCK_SIZE 65536
 
 int main(int argc, char **argv){
-	char buffer[READ_BLOCK_SIZE];
 	unsigned char *data = NULL;
-	size_t n = 0, r;
+	size_t n = 0, cap = 0, r;
+	int compress = 0, raw = 0;
+
+	for(; (argc > 2) && (argv[1][0] == '-'); argc--, argv++){
+		if(!strcmp(argv[1], "-z"))
+			compress = 1;
+		else if(!strcmp(argv[1], "-r"))
+			raw = 1;
+	}
 
 	if(argc < 2){
-		fprintf(stderr, "Usage:\n\t%s <file>\n", *argv);
+		fprintf(stderr, "Usage:\n\t%s [-z] [-r] <file>\n", *argv);
 		return 0;
 	}
 
-	FILE *source = fopen(argv[1], "r");
+	FILE *source = fopen(argv[1], "rb");
 
 	if(!source){
 		fprintf(stderr, "File not found: %s\n", argv[1]);
 		return 1;
 	}
 
-	while((r = fread(buffer, sizeof(char), READ_BLOCK_SIZE, source))){
-		n += r;
-		data = realloc(data, n * sizeof(char));
+	// Read straight into the holder, doubling it whenever it fills.
+	do {
+		if(n == cap){
+			cap = (cap ? cap * 2 : READ_BLOCK_SIZE);
+			data = realloc(data, cap * sizeof(char));
+
+			if(!data){
+				fprintf(stderr, "Failed to realloc input holder!\n");
+				return 2;
+			}
+		}
+
+		n += (r = fread(data + n, sizeof(char), cap - n, source));
+	} while(r);
+
+	fclose(source);
+
+	if(compress){
+		unsigned char *packed = lz_compress(data, n, &n);
 
-		if(!data){
-			fprintf(stderr, "Failed to realloc input holder!\n");
+		if(!packed){
+			fprintf(stderr, "Failed to compress %s!\n", argv[1]);
 			return 2;
 		}
 
-		memcpy(data + n - r, buffer, r);
+		free(data);
+		data = packed;
 	}
 
-	fclose(source);
+	if(raw){
+		fwrite(data, sizeof(char), n, stdout);
+		free(data);
+
+		return 0;
+	}
 
 	char *enc = base64_enc(data, n);
 
+	if(!enc){
+		fprintf(stderr, "Failed to encode %s!\n", argv[1]);
+		return 2;
+	}
+
 	base64_toquoted(enc, stdout);
 	free(enc);
+	free(data);
 
 	return 0;
 }
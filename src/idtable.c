@@ -0,0 +1,163 @@
+/*
+	idtable.c
+	mperron (2020)
+
+	Writes the header of asset ids (see assetid.h) for the asset paths given
+	as arguments. Usage:
+
+		idtable <header> [path...]
+
+	Each path gets an id in the asset namespace, named after the path with
+	anything but letters and digits made into underscores, so that using a
+	missing asset is a compile error. asset_names lists the paths by id, and
+	asset_displace holds each bucket's displacement.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+
+#include "assetid.h"
+
+#define MAX_DISPLACEMENT 0xffffff
+
+typedef struct {
+	const char *path;
+	char *ident;
+	uint32_t bucket;
+} asset;
+
+typedef struct {
+	int *members, count;
+	uint32_t index;
+} bucket;
+
+static int by_size(const void *a, const void *b){
+	const bucket *ba = a, *bb = b;
+
+	if(ba->count != bb->count)
+		return bb->count - ba->count;
+
+	return (int) ba->index - (int) bb->index;
+}
+
+static char *identifier(const char *path){
+	char *ident = malloc(strlen(path) + 2), *out = ident;
+
+	if(isdigit((unsigned char) *path))
+		*(out++) = '_';
+
+	for(; *path; path++)
+		*(out++) = (isalnum((unsigned char) *path) ? *path : '_');
+	*out = 0;
+
+	return ident;
+}
+
+int main(int argc, char **argv){
+	if(argc < 2){
+		fprintf(stderr, "Usage:\n\t%s <header> [path...]\n", *argv);
+		return 0;
+	}
+
+	uint32_t count = argc - 2, buckets = (count ? count : 1);
+	asset *assets = calloc(count + 1, sizeof(asset));
+	bucket *table = calloc(buckets, sizeof(bucket));
+	uint32_t *displace = calloc(buckets, sizeof(uint32_t));
+	int *ids = malloc((count + 1) * sizeof(int));
+
+	for(uint32_t i = 0; i < count; i++){
+		assets[i].path = argv[i + 2];
+		assets[i].ident = identifier(assets[i].path);
+		assets[i].bucket = asset_hash(assets[i].path, 0) % buckets;
+
+		if(!strcmp(assets[i].ident, "none")){
+			fprintf(stderr, "Asset %s would be named asset::none, which is taken\n", assets[i].path);
+			return 1;
+		}
+
+		for(uint32_t j = 0; j < i; j++)
+			if(!strcmp(assets[i].ident, assets[j].ident)){
+				fprintf(stderr, "Assets %s and %s would both be named asset::%s\n", assets[j].path, assets[i].path, assets[i].ident);
+				return 1;
+			}
+	}
+
+	for(uint32_t b = 0; b < buckets; b++){
+		table[b].index = b;
+		table[b].members = malloc((count + 1) * sizeof(int));
+	}
+
+	for(uint32_t i = 0; i < count; i++){
+		bucket *b = &table[assets[i].bucket];
+
+		b->members[b->count++] = i;
+	}
+
+	// Place the biggest buckets first, while there's the most room.
+	qsort(table, buckets, sizeof(bucket), by_size);
+
+	for(uint32_t i = 0; i < count; i++)
+		ids[i] = -1;
+
+	for(uint32_t b = 0; (b < buckets) && table[b].count; b++){
+		uint32_t d;
+
+		for(d = 1; d <= MAX_DISPLACEMENT; d++){
+			int k;
+
+			for(k = 0; k < table[b].count; k++){
+				uint32_t id = asset_hash(assets[table[b].members[k]].path, d) % count;
+				int l;
+
+				for(l = 0; l < k; l++)
+					if(asset_hash(assets[table[b].members[l]].path, d) % count == id)
+						break;
+
+				if((l < k) || (ids[id] >= 0))
+					break;
+			}
+
+			if(k == table[b].count)
+				break;
+		}
+
+		if(d > MAX_DISPLACEMENT){
+			fprintf(stderr, "Failed to find a perfect hash for the assets!\n");
+			return 1;
+		}
+
+		displace[table[b].index] = d;
+
+		for(int k = 0; k < table[b].count; k++)
+			ids[asset_hash(assets[table[b].members[k]].path, d) % count] = table[b].members[k];
+	}
+
+	FILE *out = fopen(argv[1], "w");
+
+	if(!out){
+		fprintf(stderr, "Failed to open %s for writing!\n", argv[1]);
+		return 1;
+	}
+
+	fprintf(out, "/*\n\tAuto-generated asset id file.\n*/\n");
+	fprintf(out, "#define ASSET_COUNT %u\n#define ASSET_BUCKETS %u\n\n", count, buckets);
+
+	fprintf(out, "namespace asset {\n\tenum id : int {\n");
+	for(uint32_t i = 0; i < count; i++)
+		fprintf(out, "\t\t%s = %u,\n", assets[ids[i]].ident, i);
+	fprintf(out, "\t\tnone = -1\n\t};\n}\n\n");
+
+	fprintf(out, "const char *const asset_names[ASSET_COUNT + 1] = {\n");
+	for(uint32_t i = 0; i < count; i++)
+		fprintf(out, "\t\"%s\",\n", assets[ids[i]].path);
+	fprintf(out, "\tNULL\n};\n\n");
+
+	fprintf(out, "const uint32_t asset_displace[ASSET_BUCKETS] = {");
+	for(uint32_t b = 0; b < buckets; b++)
+		fprintf(out, "%s%u", (b ? ", " : " "), displace[b]);
+	fprintf(out, " };\n");
+
+	return fclose(out);
+}
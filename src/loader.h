@@ -3,77 +3,626 @@
 	mperron (2019)
 
 	A class which models game assets. These are instantiated via the
-	automatically generated assetblob file, with base64 encoded asset
-	data.
+	automatically generated assetblob file. Normally the asset bytes are
+	embedded as-is in a read-only section of the executable (see
+	ASSET_INCBIN) and used in place, but util/encode can still produce
+	base64 encoded asset data instead, in writable arrays. That's decoded
+	in place the first time the asset is used, or ahead of time by
+	prefetch, so assets belonging to scenes that are never visited cost
+	nothing.
+
+	Assets may be compressed (see lz.h). Those are decompressed the first
+	time their data is needed, or streamed a block at a time to SDL loaders
+	which copy the data out, like music, so they're never inflated in full.
+
+	prefetch does that work ahead of time for a list of assets, such as a
+	scene's, split into pieces across a pool of threads.
+
+	An asset pack (see pak.h) can also be mounted, after which files in the
+	pack are served straight out of its mapping and take the place of any
+	built in files with the same path.
+
+	Every built in asset has an id in the generated assetids file, such as
+	asset::t2_wav for "t2.wav", and is kept in an array by id. Looking a path
+	up by string goes through the perfect hash in assetid.h to find its id,
+	and only files which are in nothing but the pack need a search.
 */
 #include "base64.h"
+#include "pak.h"
+#include "lz.h"
+#include "assetid.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#ifdef _WIN32
+#define ASSET_SECTION ".rdata,\"dr\""
+#else
+#define ASSET_SECTION ".rodata"
+#endif
+
+// Embed the file at path (relative to where the compiler runs) as the
+// read-only byte array name, followed by a NUL so text assets can be used
+// as C strings.
+#define ASSET_INCBIN(name, path) \
+	extern "C" const char name[]; \
+	__asm__( \
+		".pushsection " ASSET_SECTION "\n" \
+		".balign 16\n" \
+		#name ":\n" \
+		".incbin \"" path "\"\n" \
+		".byte 0\n" \
+		".popsection\n" \
+	);
 
 class FileLoader {
-	size_t size_raw;
-	const char *data_raw;
-	string data;
+	size_t size_raw = 0;
+	const char *data_raw = NULL;
+	char *encoded = NULL;
+
+	// Compressed data, kept for streaming after it's been inflated.
+	const char *frame = NULL;
+	size_t size_frame = 0;
+	bool compressed;
+
+	// Held while this asset's data or surface is being set up.
+	SDL_mutex *guard = SDL_CreateMutex();
 
-	static map<string, FileLoader*> assets;
+	static FileLoader *assets[ASSET_COUNT + 1];
+
+	// The mounted asset pack, and loaders for the files used from it: by
+	// id for any which replace built in assets, and by path for the rest.
+	static const char *pak;
+	static size_t pak_size;
+	static FileLoader *packed_ids[ASSET_COUNT + 1];
+	static map<string, FileLoader*> packed;
+	static SDL_mutex *lock;
+
+	static FileLoader *find_packed(const string &fname);
 
 	SDL_RWops *rw = NULL;
 	SDL_Surface *sf = NULL;
 	Mix_Music *mu = NULL;
 	Mix_Chunk *snd = NULL;
+
+	// A piece of prefetch's work, which can run on any thread.
+	struct Job {
+		enum { BASE64, BLOCK, SURFACE } kind;
+		FileLoader *fl;
+		const char *in;
+		size_t size_in;
+		char *out;
+		size_t size_out;
+		bool stored;
+		bool ok;
+
+		void run(){
+			switch(kind){
+				case BASE64:
+					SDL_LockMutex(fl->guard);
+					fl->unpack();
+					SDL_UnlockMutex(fl->guard);
+					ok = true;
+					break;
+
+				case BLOCK:
+					if(stored){
+						if((ok = (size_in == size_out)))
+							memcpy(out, in, size_out);
+					} else ok = (lz_decompress_block((const uint8_t*) in, size_in, (uint8_t*) out, size_out) == size_out);
+					break;
+
+				case SURFACE:
+					ok = (fl->surface() != NULL);
+					break;
+			}
+		}
+	};
+
+	// The jobs for one stage of prefetch, shared by the threads running
+	// them. Progress is the fraction of each stage's input handled so far,
+	// kept in thousandths of the whole prefetch.
+	struct Pool {
+		vector<Job> jobs;
+		SDL_atomic_t next;
+		SDL_mutex *lock;
+		SDL_atomic_t *progress;
+		size_t done, total;
+		int stage;
+	};
+
+	static const int DECODE_STAGES = 3;
+
+	static int worker(void *data){
+		Pool *pool = (Pool*) data;
+		int i;
+
+		while((i = SDL_AtomicAdd(&pool->next, 1)) < (int) pool->jobs.size()){
+			Job &job = pool->jobs[i];
+
+			job.run();
+
+			if(pool->progress){
+				SDL_LockMutex(pool->lock);
+				pool->done += job.size_in;
+				SDL_AtomicSet(pool->progress, (int)(1000 * (pool->stage + (double) pool->done / max(pool->total, (size_t) 1)) / DECODE_STAGES));
+				SDL_UnlockMutex(pool->lock);
+			}
+		}
+
+		return 0;
+	}
+
+	static void run_jobs(Pool &pool);
+
+	// An SDL_RWops which decompresses one block of a frame at a time.
+	struct Stream {
+		lz_header header;
+		const uint8_t *sizes;
+		vector<const uint8_t*> blocks;
+		vector<uint8_t> buffer;
+		int64_t cached = -1;
+		int64_t pos = 0;
+
+		static Sint64 size(SDL_RWops *ctx){
+			return ((Stream*) ctx->hidden.unknown.data1)->header.size;
+		}
+
+		static Sint64 seek(SDL_RWops *ctx, Sint64 offset, int whence){
+			Stream *st = (Stream*) ctx->hidden.unknown.data1;
+			Sint64 to = offset;
+
+			if(whence == RW_SEEK_CUR)
+				to += st->pos;
+			else if(whence == RW_SEEK_END)
+				to += st->header.size;
+
+			if(to < 0)
+				return -1;
+
+			return (st->pos = ((to > (Sint64) st->header.size) ? st->header.size : to));
+		}
+
+		static size_t read(SDL_RWops *ctx, void *ptr, size_t size, size_t maxnum){
+			Stream *st = (Stream*) ctx->hidden.unknown.data1;
+			uint8_t *out = (uint8_t*) ptr;
+			size_t total = size * maxnum, done = 0;
+
+			if(!size || (st->pos >= (int64_t) st->header.size))
+				return 0;
+
+			if(total > st->header.size - st->pos)
+				total = st->header.size - st->pos;
+
+			while(done < total){
+				int64_t k = st->pos / LZ_BLOCK_SIZE;
+				size_t at = st->pos % LZ_BLOCK_SIZE;
+
+				if(k != st->cached){
+					uint32_t stored = lz_read32(st->sizes + k * sizeof(uint32_t));
+
+					if(lz_block(&st->header, k, st->blocks[k], stored, &st->buffer[0]) == (size_t) -1)
+						break;
+
+					st->cached = k;
+				}
+
+				size_t n = min((size_t) LZ_BLOCK_SIZE - at, total - done);
+
+				memcpy(out + done, &st->buffer[at], n);
+				done += n;
+				st->pos += n;
+			}
+
+			return done / size;
+		}
+
+		static size_t write(SDL_RWops *ctx, const void *ptr, size_t size, size_t num){
+			return 0;
+		}
+
+		static int close(SDL_RWops *ctx){
+			delete (Stream*) ctx->hidden.unknown.data1;
+			SDL_FreeRW(ctx);
+
+			return 0;
+		}
+	};
+
+	// Decode base64 over itself, since decoding never gets ahead of the
+	// input. Called with the guard held.
+	void unpack(){
+		if(!encoded)
+			return;
+
+		base64_dec_into(encoded, (size_raw + 2) / 3 * 4, encoded, size_raw);
+		encoded[size_raw] = 0;
+
+		if(compressed){
+			frame = encoded;
+			size_frame = size_raw;
+		} else data_raw = encoded;
+
+		encoded = NULL;
+	}
+
+	// Get the data ready on first use: decode base64, and then decompress
+	// if inflating. Corrupt data leaves data_raw NULL.
+	void prepare(const bool &inflating){
+		SDL_LockMutex(guard);
+
+		unpack();
+
+		if(inflating && compressed && !data_raw && frame){
+			size_t n;
+
+			if((data_raw = (const char*) lz_decompress((const uint8_t*) frame, size_frame, &n)))
+				size_raw = n;
+			else
+				cerr << "Failed to decompress asset." << endl;
+
+			compressed = false;
+		}
+
+		SDL_UnlockMutex(guard);
+	}
+
+	// Open a new stream over the compressed data, or NULL if it's corrupt.
+	SDL_RWops *stream(){
+		Stream *st = new Stream();
+
+		if(!(st->sizes = lz_frame((const uint8_t*) frame, size_frame, &st->header))){
+			cerr << "Failed to decompress asset." << endl;
+			delete st;
+			return NULL;
+		}
+
+		const uint8_t *in = st->sizes + st->header.blocks * sizeof(uint32_t);
+
+		for(uint32_t k = 0; k < st->header.blocks; k++){
+			st->blocks.push_back(in);
+			in += lz_read32(st->sizes + k * sizeof(uint32_t)) & ~LZ_STORED;
+		}
+
+		st->buffer.resize(LZ_BLOCK_SIZE);
+
+		SDL_RWops *ctx = SDL_AllocRW();
+
+		if(!ctx){
+			delete st;
+			return NULL;
+		}
+
+		ctx->size = Stream::size;
+		ctx->seek = Stream::seek;
+		ctx->read = Stream::read;
+		ctx->write = Stream::write;
+		ctx->close = Stream::close;
+		ctx->type = SDL_RWOPS_UNKNOWN;
+		ctx->hidden.unknown.data1 = st;
+
+		return ctx;
+	}
+
+	// Data for an SDL loader which copies it out. Compressed data which
+	// hasn't been inflated is streamed, and freed by the loader.
+	SDL_RWops *reader(int &freesrc){
+		prepare(false);
+
+		SDL_LockMutex(guard);
+		freesrc = (compressed && frame);
+		SDL_UnlockMutex(guard);
+
+		return (freesrc ? stream() : rwops());
+	}
+
 public:
-	FileLoader(size_t size_raw, string data){
+	// Base64 encoded asset data in a writable array, which is decoded in
+	// place on first use.
+	FileLoader(size_t size_raw, char *encoded, bool compressed = false){
 		this->size_raw = size_raw;
-		this->data = data;
+		this->encoded = encoded;
+		this->compressed = compressed;
+	}
+
+	// Asset data embedded by ASSET_INCBIN, which is used where it is.
+	FileLoader(const char *data_raw, size_t size_raw, bool compressed = false){
+		if(compressed){
+			frame = data_raw;
+			size_frame = size_raw;
+		} else {
+			this->data_raw = data_raw;
+			this->size_raw = size_raw;
+		}
+
+		this->compressed = compressed;
 	}
 
 	// Get a surface for this asset if it's an image.
 	SDL_Surface *surface(){
-		if(!sf)
-			sf = SDL_LoadBMP_RW(rwops(), 0);
+		SDL_LockMutex(guard);
+
+		if(!sf){
+			int freesrc;
+			SDL_RWops *src = reader(freesrc);
+
+			if(src)
+				sf = SDL_LoadBMP_RW(src, freesrc);
+		}
+
+		SDL_UnlockMutex(guard);
 
 		return this->sf;
 	}
 
 	SDL_RWops *rwops(){
-		if(!rw)
-			rw = SDL_RWFromMem(((void*) data_raw), size_raw);
+		prepare(true);
+
+		if(!rw && data_raw)
+			rw = SDL_RWFromConstMem(data_raw, size_raw);
 
 		return rw;
 	}
 
 	Mix_Music *music(){
-		if(!mu)
-			mu = Mix_LoadMUS_RW(rwops(), 0);
+		if(!mu){
+			int freesrc;
+			SDL_RWops *src = reader(freesrc);
+
+			if(src)
+				mu = Mix_LoadMUS_RW(src, freesrc);
+		}
 
 		return mu;
 	}
 
 	Mix_Chunk *sound(){
-		if(!snd)
-			snd = Mix_LoadWAV_RW(rwops(), 0);
+		if(!snd){
+			int freesrc;
+			SDL_RWops *src = reader(freesrc);
+
+			if(src)
+				snd = Mix_LoadWAV_RW(src, freesrc);
+		}
 
 		return snd;
 	}
 
 	const char *text(){
+		prepare(true);
+
 		return data_raw;
 	}
 
 	static void load(string fname, FileLoader *fl);
-	static void decode_all();
-	static FileLoader *get(string);
+	static void prefetch(const list<string> &fnames, SDL_atomic_t *progress = NULL);
+	static bool mount(const char *fname);
+	static bool in_pack(const string &fname);
+	static asset::id id_of(const string &fname);
+	static const char *name(asset::id id);
+	static FileLoader *get(asset::id id);
+	static FileLoader *get(const string &fname);
 };
 
-// A map of all the assets.
-map<string, FileLoader*> FileLoader::assets;
+// All of the built in assets, by id.
+FileLoader *FileLoader::assets[ASSET_COUNT + 1];
+
+const char *FileLoader::pak = NULL;
+size_t FileLoader::pak_size = 0;
+FileLoader *FileLoader::packed_ids[ASSET_COUNT + 1];
+map<string, FileLoader*> FileLoader::packed;
+SDL_mutex *FileLoader::lock = SDL_CreateMutex();
 
 // Called by the assetblob code to create file data.
 void FileLoader::load(string fname, FileLoader *fl){
-	assets[fname] = fl;
+	asset::id id = id_of(fname);
+
+	if(id != asset::none)
+		assets[id] = fl;
+	else
+		cerr << "No asset id for: " << fname << endl;
+}
+
+// Find the id of a built in asset by its path, or asset::none.
+asset::id FileLoader::id_of(const string &fname){
+	if(!ASSET_COUNT)
+		return asset::none;
+
+	uint32_t displace = asset_displace[asset_hash(fname.c_str(), 0) % ASSET_BUCKETS];
+	uint32_t id = asset_hash(fname.c_str(), displace) % (ASSET_COUNT ? ASSET_COUNT : 1);
+
+	if(!displace || strcmp(asset_names[id], fname.c_str()))
+		return asset::none;
+
+	return (asset::id) id;
+}
+
+const char *FileLoader::name(asset::id id){
+	return (((id >= 0) && (id < ASSET_COUNT)) ? asset_names[id] : "");
+}
+
+// Map an asset pack, checking its index. Returns false if there's no pack
+// at fname, or it isn't valid. On Windows the pack is read into memory.
+bool FileLoader::mount(const char *fname){
+	const char *data = NULL;
+	size_t size = 0;
+
+#ifdef _WIN32
+	SDL_RWops *file = SDL_RWFromFile(fname, "rb");
+
+	if(!file)
+		return false;
+
+	Sint64 length = SDL_RWsize(file);
+
+	if(length > 0){
+		char *buffer = (char*) malloc(length);
+
+		if(buffer && (SDL_RWread(file, buffer, length, 1) == 1)){
+			data = buffer;
+			size = length;
+		} else free(buffer);
+	}
+
+	SDL_RWclose(file);
+#else
+	int fd = open(fname, O_RDONLY);
+	struct stat st;
+
+	if(fd < 0)
+		return false;
+
+	if(!fstat(fd, &st) && (st.st_size > 0)){
+		void *view = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+		if(view != MAP_FAILED){
+			data = (const char*) view;
+			size = st.st_size;
+		}
+	}
+
+	close(fd);
+#endif
+
+	if(!data){
+		cerr << "Failed to map asset pack: " << fname << endl;
+		return false;
+	}
+
+	// Check the header and every index entry, so lookups can trust them.
+	const pak_header *header = (const pak_header*) data;
+	bool valid = (
+		(size >= sizeof(pak_header)) &&
+		!memcmp(header->magic, PAK_MAGIC, 4) &&
+		(header->version == PAK_VERSION) &&
+		(header->count <= (size - sizeof(pak_header)) / sizeof(pak_entry))
+	);
+
+	if(valid){
+		const pak_entry *entries = (const pak_entry*)(data + sizeof(pak_header));
+
+		for(uint32_t i = 0; valid && (i < header->count); i++)
+			valid = (
+				(entries[i].name < size) &&
+				memchr(data + entries[i].name, 0, size - entries[i].name) &&
+				(entries[i].offset < size) &&
+				(entries[i].size < size - entries[i].offset) &&
+				(data[entries[i].offset + entries[i].size] == 0)
+			);
+	}
+
+	if(!valid){
+		cerr << "Invalid asset pack: " << fname << endl;
+
+#ifdef _WIN32
+		free((void*) data);
+#else
+		munmap((void*) data, size);
+#endif
+		return false;
+	}
+
+	SDL_LockMutex(lock);
+	pak = data;
+	pak_size = size;
+
+	// Look up every built in asset in the pack now, so that ids don't have
+	// to search it.
+	for(int id = 0; id < ASSET_COUNT; id++)
+		packed_ids[id] = find_packed(asset_names[id]);
+	SDL_UnlockMutex(lock);
+
+	return true;
 }
 
-// Find a file by path.
-FileLoader *FileLoader::get(string fname){
-	FileLoader *fl = assets[fname];
+// Binary search the pack's index for a path. The caller holds the lock.
+FileLoader *FileLoader::find_packed(const string &fname){
+	const pak_header *header = (const pak_header*) pak;
+	const pak_entry *entries = (const pak_entry*)(pak + sizeof(pak_header));
+	const uint32_t hash = pak_hash(fname.c_str());
+	uint32_t lo = 0, hi = header->count;
+
+	while(lo < hi){
+		uint32_t mid = lo + (hi - lo) / 2;
+		int c = pak_compare(hash, fname.c_str(), entries[mid].hash, pak + entries[mid].name);
+
+		if(!c)
+			return new FileLoader(pak + entries[mid].offset, entries[mid].size);
+
+		if(c < 0)
+			hi = mid;
+		else
+			lo = mid + 1;
+	}
+
+	return NULL;
+}
+
+// Whether a file comes from the mounted pack rather than the built in assets.
+bool FileLoader::in_pack(const string &fname){
+	asset::id id = id_of(fname);
+	bool found = false;
+
+	if(id != asset::none)
+		return (packed_ids[id] != NULL);
+
+	SDL_LockMutex(lock);
+
+	if(pak){
+		FileLoader *fl = NULL;
+
+		if(packed.count(fname) || (fl = find_packed(fname)))
+			found = true;
+
+		if(fl)
+			packed[fname] = fl;
+	}
+
+	SDL_UnlockMutex(lock);
+
+	return found;
+}
+
+// Find an asset by id, in the mounted pack first and then among the built
+// in assets. The tables are only written while assets are registered and
+// the pack is mounted at startup, so this needs no lock.
+FileLoader *FileLoader::get(asset::id id){
+	FileLoader *fl = NULL;
+
+	if((id >= 0) && (id < ASSET_COUNT) && !(fl = packed_ids[id]))
+		fl = assets[id];
+
+	if(!fl)
+		cerr << "File not found: " << name(id) << endl;
+
+	return fl;
+}
+
+// Find a file by path, which may also be a file that's only in the pack.
+// This is safe to call from more than one thread.
+FileLoader *FileLoader::get(const string &fname){
+	FileLoader *fl = NULL;
+	asset::id id = id_of(fname);
+
+	if(id != asset::none)
+		return get(id);
+
+	SDL_LockMutex(lock);
+
+	if(pak){
+		auto it = packed.find(fname);
+
+		if(it != packed.end())
+			fl = it->second;
+		else if((fl = find_packed(fname)))
+			packed[fname] = fl;
+	}
+
+	SDL_UnlockMutex(lock);
 
 	if(!fl)
 		cerr << "File not found: " << fname << endl;
@@ -81,11 +630,154 @@ FileLoader *FileLoader::get(string fname){
 	return fl;
 }
 
-// Turn the base64 encoded data into real data.
-void FileLoader::decode_all(){
-	for(auto x : assets){
-		FileLoader *fl = x.second;
+// Run a stage's jobs on one thread per core, including this one.
+void FileLoader::run_jobs(Pool &pool){
+	vector<SDL_Thread*> threads;
+	int cores = SDL_GetCPUCount();
+
+	SDL_AtomicSet(&pool.next, 0);
+	pool.done = 0;
+	pool.total = 0;
+
+	for(const Job &job : pool.jobs)
+		pool.total += job.size_in;
+
+	for(int i = 1; (i < cores) && (i < (int) pool.jobs.size()); i++){
+		SDL_Thread *thread = SDL_CreateThread(worker, "asset decoder", &pool);
+
+		if(thread)
+			threads.push_back(thread);
+	}
+
+	worker(&pool);
+
+	for(SDL_Thread *thread : threads)
+		SDL_WaitThread(thread, NULL);
+}
+
+// Decode and decompress some assets now, so their first use is quick, and
+// load any images into surfaces. That's done in three stages, across a
+// thread per core: base64 an asset at a time, then compressed data a block
+// at a time, and then images. Audio is left compressed, to be streamed. A
+// stage's output is thrown away for any asset that was set up on first use
+// meanwhile. progress, if given, is kept at the thousandths done, ending
+// at 1000. This can be called from any thread, and returns once it's done.
+void FileLoader::prefetch(const list<string> &fnames, SDL_atomic_t *progress){
+	Pool pool;
+	vector<pair<FileLoader*, string> > files;
+	vector<pair<FileLoader*, char*> > staged;
+
+	for(const string &fname : fnames){
+		FileLoader *fl = get(fname);
+
+		if(fl)
+			files.push_back(make_pair(fl, fname));
+	}
+
+	pool.lock = SDL_CreateMutex();
+	pool.progress = progress;
+
+	// Base64, which is decoded in place, so an asset can't be split between
+	// threads.
+	pool.stage = 0;
+	for(auto &file : files){
+		FileLoader *fl = file.first;
 
-		fl->data_raw = base64_dec(fl->data.c_str(), strlen(fl->data.c_str()));
+		SDL_LockMutex(fl->guard);
+
+		if(fl->encoded)
+			pool.jobs.push_back({ Job::BASE64, fl, NULL, (fl->size_raw + 2) / 3 * 4, NULL, fl->size_raw, false, false });
+
+		SDL_UnlockMutex(fl->guard);
 	}
+
+	run_jobs(pool);
+
+	// Compressed blocks. Audio is left compressed, since it's streamed a
+	// block at a time to the mixer when it's loaded.
+	pool.stage = 1;
+	pool.jobs.clear();
+	staged.clear();
+	for(auto &file : files){
+		FileLoader *fl = file.first;
+		const string &fname = file.second;
+		lz_header header;
+		const uint8_t *sizes;
+
+		if((fname.length() > 4) && !fname.compare(fname.length() - 4, 4, ".wav"))
+			continue;
+
+		SDL_LockMutex(fl->guard);
+
+		if(fl->compressed && !fl->data_raw && fl->frame){
+			if((sizes = lz_frame((const uint8_t*) fl->frame, fl->size_frame, &header))){
+				const char *in = (const char*)(sizes + header.blocks * sizeof(uint32_t));
+				char *out = (char*) malloc(header.size + 1);
+
+				if(!out){
+					cerr << "Failed to allocate for asset: " << fname << endl;
+					SDL_UnlockMutex(fl->guard);
+					continue;
+				}
+
+				out[header.size] = 0;
+
+				for(uint32_t k = 0; k < header.blocks; k++){
+					uint32_t stored = lz_read32(sizes + k * sizeof(uint32_t));
+					size_t raw = min((uint64_t) LZ_BLOCK_SIZE, header.size - (uint64_t) k * LZ_BLOCK_SIZE);
+
+					pool.jobs.push_back({ Job::BLOCK, fl, in, stored & ~LZ_STORED, out + (size_t) k * LZ_BLOCK_SIZE, raw, (stored & LZ_STORED) != 0, false });
+					in += (stored & ~LZ_STORED);
+				}
+
+				staged.push_back(make_pair(fl, out));
+			} else cerr << "Failed to decompress asset: " << fname << endl;
+		}
+
+		SDL_UnlockMutex(fl->guard);
+	}
+
+	run_jobs(pool);
+
+	for(auto &x : staged){
+		FileLoader *fl = x.first;
+		bool ok = true;
+		lz_header header;
+
+		for(const Job &job : pool.jobs)
+			if(job.fl == fl)
+				ok = (ok && job.ok);
+
+		SDL_LockMutex(fl->guard);
+
+		if(ok && fl->compressed && !fl->data_raw && lz_frame((const uint8_t*) fl->frame, fl->size_frame, &header)){
+			fl->data_raw = x.second;
+			fl->size_raw = header.size;
+			fl->compressed = false;
+		} else free(x.second);
+
+		SDL_UnlockMutex(fl->guard);
+	}
+
+	// Images, which SDL can load into surfaces on any thread.
+	pool.stage = 2;
+	pool.jobs.clear();
+	for(auto &file : files){
+		FileLoader *fl = file.first;
+		const string &fname = file.second;
+
+		SDL_LockMutex(fl->guard);
+
+		if((fname.length() > 4) && !fname.compare(fname.length() - 4, 4, ".bmp") && !fl->sf && fl->data_raw)
+			pool.jobs.push_back({ Job::SURFACE, fl, NULL, fl->size_raw, NULL, 0, false, false });
+
+		SDL_UnlockMutex(fl->guard);
+	}
+
+	run_jobs(pool);
+
+	if(progress)
+		SDL_AtomicSet(progress, 1000);
+
+	SDL_DestroyMutex(pool.lock);
 }
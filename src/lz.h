@@ -0,0 +1,314 @@
+/*
+	A small LZ77 codec for assets, in the style of LZ4: byte aligned
+	sequences of literals and back references, with no entropy coding, so
+	that decompression is little more than memcpy.
+
+	Data is compressed in independent blocks of LZ_BLOCK_SIZE bytes, so any
+	block can be decompressed on its own. A frame holds a header, the stored
+	size of each block, and then the blocks. A block which wouldn't shrink is
+	stored as-is, and marked with LZ_STORED.
+
+	Each sequence in a block is a token byte, holding a literal count in the
+	high nibble and a match length (less LZ_MIN_MATCH) in the low nibble. A
+	nibble of 15 is followed by more length bytes, added together until one
+	is below 255. Then come the literals, and then the match offset as two
+	little-endian bytes. The last sequence of a block has literals only.
+*/
+#ifndef QS_LZ_H
+#define QS_LZ_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define LZ_MAGIC "PGLZ"
+#define LZ_BLOCK_SIZE 65536
+#define LZ_STORED 0x80000000u
+#define LZ_MIN_MATCH 4
+#define LZ_HASH_BITS 14
+#define LZ_CHAIN_DEPTH 64
+
+typedef struct {
+	char magic[4];
+	uint32_t blocks;
+	uint64_t size;
+} lz_header;
+
+// The most a block of n bytes can take up once compressed.
+static inline size_t lz_bound(size_t n){
+	return n + n / 255 + 16;
+}
+
+static inline uint32_t lz_read32(const uint8_t *p){
+	uint32_t v;
+
+	memcpy(&v, p, 4);
+	return v;
+}
+
+static inline uint8_t *lz_write_length(uint8_t *out, size_t n){
+	for(; n >= 255; n -= 255)
+		*(out++) = 255;
+
+	*(out++) = (uint8_t) n;
+	return out;
+}
+
+// Compress n bytes (no more than LZ_BLOCK_SIZE) into out, which must hold
+// lz_bound(n) bytes. Returns the compressed size, or 0 if out of memory.
+// Every earlier position with the same hash is chained together, and the
+// longest of the first LZ_CHAIN_DEPTH matches is used: slow, but this only
+// runs when assets are built.
+static inline size_t lz_compress_block(const uint8_t *in, size_t n, uint8_t *out){
+	uint32_t *head = (uint32_t*) malloc(sizeof(uint32_t) << LZ_HASH_BITS);
+	uint32_t *prev = (uint32_t*) malloc(sizeof(uint32_t) * (n + 1));
+	const uint8_t *anchor = in, *end = in + n;
+	uint8_t *o = out;
+	size_t i = 0, inserted = 0;
+
+	if(!head || !prev){
+		free(head);
+		free(prev);
+		return 0;
+	}
+
+	memset(head, 0xff, sizeof(uint32_t) << LZ_HASH_BITS);
+
+	while(i + LZ_MIN_MATCH <= n){
+		// Chain in every position up to this one.
+		for(; inserted <= i; inserted++){
+			uint32_t h = (lz_read32(in + inserted) * 2654435761u) >> (32 - LZ_HASH_BITS);
+
+			prev[inserted] = head[h];
+			head[h] = inserted;
+		}
+
+		size_t length = 0, offset = 0;
+		uint32_t candidate = prev[i];
+
+		for(int depth = 0; (candidate != 0xffffffffu) && (i - candidate <= 0xffff) && (depth < LZ_CHAIN_DEPTH); candidate = prev[candidate], depth++){
+			if(in[candidate + length] != in[i + length])
+				continue;
+
+			size_t l = 0;
+
+			while((i + l < n) && (in[candidate + l] == in[i + l]))
+				l++;
+
+			if(l > length){
+				length = l;
+				offset = i - candidate;
+
+				if(i + l == n)
+					break;
+			}
+		}
+
+		if(length < LZ_MIN_MATCH){
+			i++;
+			continue;
+		}
+
+		size_t literals = (in + i) - anchor;
+		size_t extra = length - LZ_MIN_MATCH;
+		uint8_t *token = o++;
+
+		*token = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+		if(literals >= 15)
+			o = lz_write_length(o, literals - 15);
+
+		memcpy(o, anchor, literals);
+		o += literals;
+
+		*(o++) = (uint8_t)(offset & 0xff);
+		*(o++) = (uint8_t)(offset >> 8);
+
+		*token |= (uint8_t)((extra < 15) ? extra : 15);
+		if(extra >= 15)
+			o = lz_write_length(o, extra - 15);
+
+		i += length;
+		anchor = in + i;
+	}
+
+	// Whatever is left goes out as literals.
+	size_t literals = end - anchor;
+
+	*(o++) = (uint8_t)(((literals < 15) ? literals : 15) << 4);
+	if(literals >= 15)
+		o = lz_write_length(o, literals - 15);
+
+	memcpy(o, anchor, literals);
+	o += literals;
+
+	free(head);
+	free(prev);
+
+	return o - out;
+}
+
+// Decompress a block into out, which holds cap bytes. Returns the size of
+// the data, or (size_t) -1 if the block is corrupt.
+static inline size_t lz_decompress_block(const uint8_t *in, size_t n, uint8_t *out, size_t cap){
+	const uint8_t *end = in + n;
+	uint8_t *o = out, *o_end = out + cap;
+
+	while(in < end){
+		uint8_t token = *(in++);
+		size_t literals = token >> 4, length = token & 15, b;
+
+		if(literals == 15)
+			do {
+				if(in >= end)
+					return (size_t) -1;
+
+				literals += (b = *(in++));
+			} while(b == 255);
+
+		if(((size_t)(end - in) < literals) || ((size_t)(o_end - o) < literals))
+			return (size_t) -1;
+
+		memcpy(o, in, literals);
+		o += literals;
+		in += literals;
+
+		// The last sequence has no match.
+		if(in == end)
+			break;
+
+		if(end - in < 2)
+			return (size_t) -1;
+
+		size_t offset = in[0] | (in[1] << 8);
+		in += 2;
+
+		if(length == 15)
+			do {
+				if(in >= end)
+					return (size_t) -1;
+
+				length += (b = *(in++));
+			} while(b == 255);
+
+		length += LZ_MIN_MATCH;
+
+		if(!offset || (offset > (size_t)(o - out)) || ((size_t)(o_end - o) < length))
+			return (size_t) -1;
+
+		// Matches may overlap what they're copying, which repeats it.
+		const uint8_t *from = o - offset;
+
+		if(offset >= length){
+			memcpy(o, from, length);
+			o += length;
+		} else while(length--)
+			*(o++) = *(from++);
+	}
+
+	return o - out;
+}
+
+// Compress n bytes into a newly allocated frame, setting *out_len.
+static inline uint8_t *lz_compress(const uint8_t *in, size_t n, size_t *out_len){
+	uint32_t blocks = (n + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE;
+	size_t header = sizeof(lz_header) + blocks * sizeof(uint32_t);
+	uint8_t *frame = (uint8_t*) malloc(header + blocks * lz_bound(LZ_BLOCK_SIZE) + 1);
+	uint8_t *o = frame + header;
+	lz_header h;
+
+	if(!frame)
+		return NULL;
+
+	memcpy(h.magic, LZ_MAGIC, 4);
+	h.blocks = blocks;
+	h.size = n;
+	memcpy(frame, &h, sizeof(h));
+
+	for(uint32_t k = 0; k < blocks; k++){
+		size_t raw = ((k + 1 < blocks) ? LZ_BLOCK_SIZE : (n - (size_t) k * LZ_BLOCK_SIZE));
+		const uint8_t *src = in + (size_t) k * LZ_BLOCK_SIZE;
+		uint32_t stored = lz_compress_block(src, raw, o);
+
+		if(!stored || (stored >= raw)){
+			memcpy(o, src, raw);
+			stored = raw | LZ_STORED;
+		}
+
+		memcpy(frame + sizeof(lz_header) + k * sizeof(uint32_t), &stored, sizeof(stored));
+		o += (stored & ~LZ_STORED);
+	}
+
+	*out_len = o - frame;
+	return frame;
+}
+
+// Check a frame's header and block table against its length, filling in
+// the header. Returns a pointer to the block sizes, or NULL.
+static inline const uint8_t *lz_frame(const uint8_t *frame, size_t n, lz_header *h){
+	if(n < sizeof(lz_header))
+		return NULL;
+
+	memcpy(h, frame, sizeof(lz_header));
+
+	if(memcmp(h->magic, LZ_MAGIC, 4) || (h->blocks != (h->size + LZ_BLOCK_SIZE - 1) / LZ_BLOCK_SIZE))
+		return NULL;
+
+	if((n - sizeof(lz_header)) / sizeof(uint32_t) < h->blocks)
+		return NULL;
+
+	size_t total = sizeof(lz_header) + h->blocks * sizeof(uint32_t);
+
+	for(uint32_t k = 0; k < h->blocks; k++)
+		total += lz_read32(frame + sizeof(lz_header) + k * sizeof(uint32_t)) & ~LZ_STORED;
+
+	return ((total <= n) ? (frame + sizeof(lz_header)) : NULL);
+}
+
+// Decompress block k of a checked frame, starting at in, into out. Returns
+// the block's size, or (size_t) -1 if it's corrupt.
+static inline size_t lz_block(const lz_header *h, uint32_t k, const uint8_t *in, uint32_t stored, uint8_t *out){
+	size_t raw = ((k + 1 < h->blocks) ? LZ_BLOCK_SIZE : (size_t)(h->size - (uint64_t) k * LZ_BLOCK_SIZE));
+
+	if(stored & LZ_STORED){
+		if((stored & ~LZ_STORED) != raw)
+			return (size_t) -1;
+
+		memcpy(out, in, raw);
+		return raw;
+	}
+
+	return ((lz_decompress_block(in, stored, out, raw) == raw) ? raw : (size_t) -1);
+}
+
+// Decompress a whole frame into a newly allocated buffer, with a NUL after
+// the data. Returns NULL if the frame is corrupt.
+static inline uint8_t *lz_decompress(const uint8_t *frame, size_t n, size_t *out_len){
+	lz_header h;
+	const uint8_t *sizes = lz_frame(frame, n, &h);
+
+	if(!sizes)
+		return NULL;
+
+	uint8_t *out = (uint8_t*) malloc(h.size + 1);
+	const uint8_t *in = sizes + h.blocks * sizeof(uint32_t);
+
+	if(!out)
+		return NULL;
+
+	for(uint32_t k = 0; k < h.blocks; k++){
+		uint32_t stored = lz_read32(sizes + k * sizeof(uint32_t));
+
+		if(lz_block(&h, k, in, stored, out + (size_t) k * LZ_BLOCK_SIZE) == (size_t) -1){
+			free(out);
+			return NULL;
+		}
+
+		in += (stored & ~LZ_STORED);
+	}
+
+	out[h.size] = 0;
+	*out_len = h.size;
+	return out;
+}
+
+#endif
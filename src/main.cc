@@ -21,7 +21,11 @@ using namespace std;
 
 int render_scale = 5;
 
+// Ids for every asset, and the table for looking them up by path.
+#include "assetids"
+
 #include "loader.h"
+#include "meshdata.h"
 #include "saveload.h"
 #include "utility.h"
 #include "drawable.h"
@@ -31,13 +35,16 @@ int render_scale = 5;
 
 #include "text.h"
 #include "scene.h"
+#include "postfx.h"
 #include "scene3d.h"
 #include "particle.h"
+#include "particle3d.h"
 #include "button.h"
 #include "card.h"
 
 // Particle effects
 #include "snow.h"
+#include "snow3d.h"
 
 // Scenes
 #include "scenes/intro.h"
@@ -48,9 +55,25 @@ int render_scale = 5;
 #include "scenes/cards.h"
 #include "scenes/test3d.h"
 
+// Asset data, embedded raw or encoded into writable arrays.
+#include "assetdata"
+
+// Where small images were packed into atlases.
+#include "atlasmap"
+
 int main(int argc, char **argv){
 #include "assetblob"
 
+	// An asset pack beside the executable takes the place of built in assets.
+	{
+		char *base = SDL_GetBasePath();
+
+		if(base){
+			FileLoader::mount((string(base) + "assets.pak").c_str());
+			SDL_free(base);
+		}
+	}
+
 	SDL_Event event;
 
     if(SDL_Init(SDL_INIT_EVERYTHING)){
@@ -83,18 +106,22 @@ int main(int argc, char **argv){
 	SDL_SetRenderDrawBlendMode(rend, SDL_BLENDMODE_BLEND);
 	SDL_RenderSetLogicalSize(rend, SCREEN_WIDTH, SCREEN_HEIGHT);
 
-	SDL_Texture *mouse_tx_2 = textureFromBmp(rend, "mouse/cursor2.bmp", true);
+	TextureRef *mouse_tx_2 = new TextureRef(rend, asset::mouse_cursor2_bmp, true);
 
 	map<int, bool> *keys = new map<int, bool>();
 
-	// Create pointers to scene constructors by name.
-	Scene::reg("intro", scene_create<IntroSplashScene>);
-	Scene::reg("living", scene_create<LivingRoomScene>);
-	Scene::reg("jeep", scene_create<JeepScene>);
-	Scene::reg("garage", scene_create<GarageScene>);
-	Scene::reg("forest", scene_create<ForestScene>);
-	Scene::reg("cards", scene_create<CardsScene>);
-	Scene::reg("test3d", scene_create<TestScene3D>);
+	// Create pointers to scene constructors by name, with the assets each
+	// one can have preloaded.
+	Scene::reg("intro", scene_create<IntroSplashScene>, { asset::krakcircle_bmp, asset::sound_stinger_wav });
+	Scene::reg("living", scene_create<LivingRoomScene>, { asset::living_1_bmp, asset::atari_wav });
+	Scene::reg("jeep", scene_create<JeepScene>, { asset::jeep_bmp });
+	Scene::reg("garage", scene_create<GarageScene>, { asset::garage_bmp });
+	Scene::reg("forest", scene_create<ForestScene>, { asset::pict0007_bmp, asset::fonts_24x28_bmp });
+	Scene::reg("cards", scene_create<CardsScene>, { asset::pict0007_bmp });
+	Scene::reg("test3d", scene_create<TestScene3D>, { asset::models_test_room_mesh, asset::models_wizard_mesh, asset::models_wizard_anim });
+
+	// Meshes are parsed as well as decoded when they're preloaded.
+	Scene::prepare_with(".mesh", Scene3D::Mesh::preparse);
 
 	// Frame timer for FPS display
 	int frame_counter = 0;
@@ -0,0 +1,556 @@
+/*
+	MeshData
+	mperron (2020)
+
+	Plain mesh data as read from a .mesh asset, with no dependency on SDL so
+	that it can be used both by the game's loader and by offline tools. The
+	optimizer welds duplicate vertices, triangulates polygons by ear
+	clipping, and reorders triangles and vertices for locality.
+*/
+#ifndef MESHDATA_H
+#define MESHDATA_H
+
+#define MESHDATA_WELD_EPSILON 0.0005
+#define MESHDATA_CACHE_SIZE   32
+
+struct MeshData {
+	struct vertex {
+		double x, y, z;
+	};
+
+	struct polygon {
+		vector<int> verts;
+
+		// Either empty, or a u,v pair for each entry in verts.
+		vector<double> uvs;
+
+		// Fill color as written in the file: red, green, blue, alpha.
+		unsigned char color[4];
+
+		// Texture asset path, if the polygon is textured.
+		string texture;
+	};
+
+	vector<vertex> vertices;
+	vector<polygon> polygons;
+
+	// Where each vertex numbered as in the file ended up after welding and
+	// reordering, or -1 if it was dropped. Empty until one of those runs.
+	vector<int> source_map;
+
+	// Apply a renumbering of the current vertices to source_map.
+	void remap_sources(const vector<int> &remap){
+		if(source_map.empty())
+			for(size_t i = 0; i < remap.size(); i++)
+				source_map.push_back(i);
+
+		for(int &s : source_map)
+			s = ((s < 0) ? -1 : remap[s]);
+	}
+
+	// Parse the text of a .mesh file. Every mesh block in the file is merged
+	// into this one. Returns false if the data is malformed.
+	bool parse(const char *text){
+		stringstream data(text);
+		int vert_offset = vertices.size();
+
+		// Match a string identifier opening a curly brace block
+		regex rx_mesh_start("\\s*(\\S*)\\s*\\{\\s*");
+		regex rx_mesh_end("\\s*\\}\\s*");
+		regex rx_braced("\\s*\\{([^\\}]*)\\}(.*)");
+		regex rx_spaced_numbers("[0-9.-]+");
+		regex rx_rgba(".*([0-9a-fA-F]{2})([0-9a-fA-F]{2})([0-9a-fA-F]{2})([0-9a-fA-F]{2}).*");
+		regex rx_uvs("(.*)\\(([^\\)]*)\\)(.*)");
+		regex rx_texture("(.*)@(\\S+)(.*)");
+
+		// Parse all mesh data from resource.
+		string line;
+		while(getline(data, line)){
+			if(line.length() == 0)
+				continue;
+
+			// Out of data to parse.
+			if(line == "EOF")
+				break;
+
+			smatch sm;
+			if(regex_match(line, sm, rx_mesh_start)){
+				int verts = 0;
+
+				while(getline(data, line)){
+					if(line.length() == 0)
+						continue;
+
+					// Move up a level.
+					if(regex_match(line, rx_mesh_end))
+						break;
+
+					// Found a new block element.
+					if(regex_match(line, sm, rx_mesh_start)){
+						string mesh_element = sm[1];
+
+						bool faces_element = (mesh_element == "faces");
+						bool coords_element = (mesh_element == "coords");
+
+						while(getline(data, line)){
+							if(line.length() == 0)
+								continue;
+
+							// Move up a level.
+							if(regex_match(line, rx_mesh_end))
+								break;
+
+							if(!(coords_element || faces_element) || !regex_match(line, sm, rx_braced))
+								continue;
+
+							string braced_data = sm[1];
+							string braced_data_extra = sm[2];
+
+							if(coords_element){
+								double pt[3] = { 0, 0, 0 };
+
+								for(int i = 0; (i < 3) && regex_search(braced_data, sm, rx_spaced_numbers); i++){
+									pt[i] = atof(sm[0].str().c_str());
+									braced_data = sm.suffix().str();
+								}
+
+								vertices.push_back((vertex){ pt[0], pt[1], pt[2] });
+								verts++;
+							}
+
+							if(faces_element){
+								polygon poly;
+
+								memset(poly.color, 0xff, 4);
+
+								// Drop the trailing comment.
+								braced_data_extra = braced_data_extra.substr(0, braced_data_extra.find('#'));
+
+								// Texture coordinates are in parentheses, u then v for each vertex.
+								if(regex_match(braced_data_extra, sm, rx_uvs)){
+									string uv_data = sm[2];
+
+									braced_data_extra = sm[1].str() + sm[3].str();
+									while(regex_search(uv_data, sm, rx_spaced_numbers)){
+										poly.uvs.push_back(atof(sm[0].str().c_str()));
+										uv_data = sm.suffix().str();
+									}
+								}
+
+								// The texture asset path follows an at sign.
+								if(regex_match(braced_data_extra, sm, rx_texture)){
+									poly.texture = sm[2];
+									braced_data_extra = sm[1].str() + sm[3].str();
+								}
+
+								// Get the fill color for this face.
+								if(regex_match(braced_data_extra, sm, rx_rgba))
+									for(int i = 0; i < 4; i++)
+										poly.color[i] = strtol(sm[i + 1].str().c_str(), NULL, 16);
+
+								while(regex_search(braced_data, sm, rx_spaced_numbers)){
+									poly.verts.push_back(vert_offset + atoi(sm[0].str().c_str()));
+									braced_data = sm.suffix().str();
+								}
+
+								if(poly.texture.empty() || (poly.uvs.size() != (2 * poly.verts.size()))){
+									poly.texture.clear();
+									poly.uvs.clear();
+								}
+
+								if(poly.verts.size())
+									polygons.push_back(poly);
+							}
+						}
+					}
+
+					if(line == "EOF")
+						return false;
+				}
+
+				vert_offset += verts;
+			}
+		}
+
+		// Throw away polygons which refer to vertices that don't exist.
+		for(auto it = polygons.begin(); it != polygons.end();){
+			bool valid = true;
+
+			for(int v : it->verts)
+				if((v < 0) || (v >= (int) vertices.size()))
+					valid = false;
+
+			it = (valid ? (it + 1) : polygons.erase(it));
+		}
+
+		return true;
+	}
+
+	// Write this data out in the .mesh format, as a single mesh block.
+	void write(ostream &out, const string &name) const {
+		char buf[64];
+
+		out << name << " {" << endl << "\tcoords {" << endl;
+		for(size_t i = 0; i < vertices.size(); i++){
+			snprintf(buf, sizeof(buf), "\t\t{ %0.4f %0.4f %0.4f } # Vert %3d", vertices[i].x, vertices[i].y, vertices[i].z, (int) i);
+			out << buf << endl;
+		}
+
+		out << "\t}" << endl << "\tfaces {" << endl;
+		for(size_t i = 0; i < polygons.size(); i++){
+			const polygon &poly = polygons[i];
+
+			out << "\t\t{ ";
+			for(int v : poly.verts){
+				snprintf(buf, sizeof(buf), "%3d ", v);
+				out << buf;
+			}
+
+			snprintf(buf, sizeof(buf), "} %02x%02x%02x%02x", poly.color[0], poly.color[1], poly.color[2], poly.color[3]);
+			out << buf;
+
+			if(!poly.texture.empty()){
+				out << " (";
+				for(double uv : poly.uvs){
+					snprintf(buf, sizeof(buf), " %0.4f", uv);
+					out << buf;
+				}
+				out << " ) @" << poly.texture;
+			}
+
+			out << " # Face " << i << endl;
+		}
+
+		out << "\t}" << endl << "}" << endl << endl << "EOF" << endl;
+	}
+
+	// Merge vertices which are within epsilon of each other. Vertices are
+	// hashed into a grid of epsilon-sized cells, so only the neighbouring
+	// cells have to be searched for a match.
+	void weld(const double &epsilon = MESHDATA_WELD_EPSILON){
+		unordered_map<uint64_t, vector<int>> grid;
+		vector<int> remap(vertices.size());
+		vector<vertex> welded;
+
+		auto cell_key = [](int64_t x, int64_t y, int64_t z) -> uint64_t {
+			return (((uint64_t)(x & 0x1fffff)) << 42) | (((uint64_t)(y & 0x1fffff)) << 21) | ((uint64_t)(z & 0x1fffff));
+		};
+
+		for(size_t i = 0; i < vertices.size(); i++){
+			const vertex &v = vertices[i];
+			int64_t cx = (int64_t) floor(v.x / epsilon);
+			int64_t cy = (int64_t) floor(v.y / epsilon);
+			int64_t cz = (int64_t) floor(v.z / epsilon);
+			int found = -1;
+
+			for(int dx = -1; (dx <= 1) && (found < 0); dx++){
+				for(int dy = -1; (dy <= 1) && (found < 0); dy++){
+					for(int dz = -1; (dz <= 1) && (found < 0); dz++){
+						auto it = grid.find(cell_key(cx + dx, cy + dy, cz + dz));
+
+						if(it == grid.end())
+							continue;
+
+						for(int w : it->second){
+							const vertex &o = welded[w];
+
+							if((fabs(o.x - v.x) <= epsilon) && (fabs(o.y - v.y) <= epsilon) && (fabs(o.z - v.z) <= epsilon)){
+								found = w;
+								break;
+							}
+						}
+					}
+				}
+			}
+
+			if(found < 0){
+				found = welded.size();
+				welded.push_back(v);
+				grid[cell_key(cx, cy, cz)].push_back(found);
+			}
+
+			remap[i] = found;
+		}
+
+		vertices = welded;
+		remap_sources(remap);
+
+		// Renumber polygon corners, and drop corners which collapsed onto
+		// the previous one.
+		for(auto it = polygons.begin(); it != polygons.end();){
+			polygon &poly = *it;
+			vector<int> verts;
+			vector<double> uvs;
+
+			for(size_t i = 0; i < poly.verts.size(); i++){
+				int v = remap[poly.verts[i]];
+
+				if(verts.size() && ((verts.back() == v) || ((i == poly.verts.size() - 1) && (verts.front() == v))))
+					continue;
+
+				verts.push_back(v);
+				if(poly.uvs.size()){
+					uvs.push_back(poly.uvs[2 * i]);
+					uvs.push_back(poly.uvs[2 * i + 1]);
+				}
+			}
+
+			poly.verts = verts;
+			poly.uvs = uvs;
+
+			it = ((poly.verts.size() >= 3) ? (it + 1) : polygons.erase(it));
+		}
+	}
+
+	// Split every polygon with more than three corners into triangles by
+	// ear clipping, which also handles concave polygons. Triangles keep the
+	// winding order, color and texture of the polygon they came from.
+	void triangulate(){
+		vector<polygon> triangles;
+
+		for(const polygon &poly : polygons){
+			const int n = poly.verts.size();
+
+			if(n == 3){
+				triangles.push_back(poly);
+				continue;
+			}
+
+			// Newell's method gives the polygon normal even when it's
+			// concave. Project onto the plane of its two smallest components.
+			double nx = 0, ny = 0, nz = 0;
+			for(int i = 0; i < n; i++){
+				const vertex &a = vertices[poly.verts[i]];
+				const vertex &b = vertices[poly.verts[(i + 1) % n]];
+
+				nx += (a.y - b.y) * (a.z + b.z);
+				ny += (a.z - b.z) * (a.x + b.x);
+				nz += (a.x - b.x) * (a.y + b.y);
+			}
+
+			int axis = ((fabs(nx) > fabs(ny)) ? ((fabs(nx) > fabs(nz)) ? 0 : 2) : ((fabs(ny) > fabs(nz)) ? 1 : 2));
+			double sign = ((axis == 0) ? nx : ((axis == 1) ? ny : nz)) < 0 ? -1 : 1;
+
+			vector<double> px(n), py(n);
+			for(int i = 0; i < n; i++){
+				const vertex &v = vertices[poly.verts[i]];
+
+				switch(axis){
+					case 0:
+						px[i] = v.y;
+						py[i] = v.z * sign;
+						break;
+					case 1:
+						px[i] = v.z;
+						py[i] = v.x * sign;
+						break;
+					default:
+						px[i] = v.x;
+						py[i] = v.y * sign;
+						break;
+				}
+			}
+
+			// Signed area of the 2D triangle a, b, c. Positive if it winds the
+			// same way as the polygon.
+			auto area = [&](int a, int b, int c) -> double {
+				return ((px[b] - px[a]) * (py[c] - py[a]) - (px[c] - px[a]) * (py[b] - py[a]));
+			};
+
+			vector<int> ring(n);
+			for(int i = 0; i < n; i++)
+				ring[i] = i;
+
+			int guard = 0;
+			for(int i = 0; ring.size() > 3;){
+				int m = ring.size();
+				int a = ring[(i + m - 1) % m], b = ring[i % m], c = ring[(i + 1) % m];
+				bool ear = (area(a, b, c) > 0);
+
+				// An ear may not contain any of the remaining corners.
+				for(int j = 0; ear && (j < m); j++){
+					int p = ring[j];
+
+					if((p == a) || (p == b) || (p == c))
+						continue;
+
+					if((area(a, b, p) >= 0) && (area(b, c, p) >= 0) && (area(c, a, p) >= 0))
+						ear = false;
+				}
+
+				// Degenerate input may have no ears left; clip anyway rather
+				// than loop forever.
+				if(ear || (guard >= m)){
+					polygon tri = poly;
+					int corners[3] = { a, b, c };
+
+					tri.verts.clear();
+					tri.uvs.clear();
+					for(int k : corners){
+						tri.verts.push_back(poly.verts[k]);
+						if(poly.uvs.size()){
+							tri.uvs.push_back(poly.uvs[2 * k]);
+							tri.uvs.push_back(poly.uvs[2 * k + 1]);
+						}
+					}
+
+					triangles.push_back(tri);
+					ring.erase(ring.begin() + (i % m));
+					guard = 0;
+				} else {
+					i = (i + 1) % m;
+					guard++;
+				}
+			}
+
+			polygon tri = poly;
+			tri.verts.clear();
+			tri.uvs.clear();
+			for(int k : ring){
+				tri.verts.push_back(poly.verts[k]);
+				if(poly.uvs.size()){
+					tri.uvs.push_back(poly.uvs[2 * k]);
+					tri.uvs.push_back(poly.uvs[2 * k + 1]);
+				}
+			}
+			triangles.push_back(tri);
+		}
+
+		polygons = triangles;
+	}
+
+	// Reorder polygons so that consecutive ones share vertices, using Tom
+	// Forsyth's linear-speed vertex cache optimization, then renumber the
+	// vertices in the order they are first used.
+	void reorder(){
+		const int count = polygons.size();
+		const int vcount = vertices.size();
+
+		if(!count)
+			return;
+
+		// Polygons using each vertex, and how many of those are not yet
+		// emitted.
+		vector<vector<int>> users(vcount);
+		for(int p = 0; p < count; p++)
+			for(int v : polygons[p].verts)
+				users[v].push_back(p);
+
+		vector<int> remaining(vcount), cache_pos(vcount, -1);
+		vector<double> vscore(vcount), pscore(count, 0);
+		vector<bool> emitted(count, false);
+
+		auto vertex_score = [&](int v) -> double {
+			if(!remaining[v])
+				return -1.0;
+
+			double score = 0;
+			int pos = cache_pos[v];
+
+			if(pos >= 0){
+				if(pos < 3)
+					score = 0.75;
+				else
+					score = pow(1.0 - (double)(pos - 3) / (MESHDATA_CACHE_SIZE - 3), 1.5);
+			}
+
+			// Favour vertices with few polygons left, to finish them off.
+			return score + 2.0 * pow((double) remaining[v], -0.5);
+		};
+
+		for(int v = 0; v < vcount; v++){
+			remaining[v] = users[v].size();
+			vscore[v] = vertex_score(v);
+		}
+		for(int p = 0; p < count; p++)
+			for(int v : polygons[p].verts)
+				pscore[p] += vscore[v];
+
+		vector<int> order, cache;
+		int best = -1;
+
+		while((int) order.size() < count){
+			// With nothing in the cache to go on, take the best remaining
+			// polygon overall.
+			if(best < 0){
+				double best_score = -1e300;
+
+				for(int p = 0; p < count; p++){
+					if(!emitted[p] && (pscore[p] > best_score)){
+						best_score = pscore[p];
+						best = p;
+					}
+				}
+			}
+
+			emitted[best] = true;
+			order.push_back(best);
+
+			// Move this polygon's vertices to the front of the cache.
+			vector<int> next_cache(polygons[best].verts);
+			for(int v : polygons[best].verts)
+				remaining[v]--;
+			for(int v : cache)
+				if(find(next_cache.begin(), next_cache.end(), v) == next_cache.end())
+					next_cache.push_back(v);
+
+			// Rescore every vertex in or just pushed out of the cache.
+			for(size_t i = 0; i < next_cache.size(); i++)
+				cache_pos[next_cache[i]] = ((i < MESHDATA_CACHE_SIZE) ? i : -1);
+
+			best = -1;
+			double best_score = -1e300;
+
+			for(int v : next_cache){
+				double score = vertex_score(v);
+				double delta = score - vscore[v];
+
+				vscore[v] = score;
+				for(int p : users[v]){
+					if(emitted[p])
+						continue;
+
+					pscore[p] += delta;
+					if(pscore[p] > best_score){
+						best_score = pscore[p];
+						best = p;
+					}
+				}
+			}
+
+			if(next_cache.size() > MESHDATA_CACHE_SIZE)
+				next_cache.resize(MESHDATA_CACHE_SIZE);
+			cache = next_cache;
+		}
+
+		// Apply the polygon order, and number vertices by first use.
+		vector<polygon> sorted;
+		vector<int> remap(vcount, -1);
+		vector<vertex> sorted_vertices;
+
+		for(int p : order){
+			sorted.push_back(polygons[p]);
+
+			for(int &v : sorted.back().verts){
+				if(remap[v] < 0){
+					remap[v] = sorted_vertices.size();
+					sorted_vertices.push_back(vertices[v]);
+				}
+
+				v = remap[v];
+			}
+		}
+
+		polygons = sorted;
+		vertices = sorted_vertices;
+		remap_sources(remap);
+	}
+
+	void optimize(const double &epsilon = MESHDATA_WELD_EPSILON){
+		weld(epsilon);
+		triangulate();
+		reorder();
+	}
+};
+
+#endif
@@ -0,0 +1,61 @@
+/*
+	meshopt.cc
+	mperron (2020)
+
+	Reads a .mesh file exported from Blender and writes an optimized copy to
+	stdout: vertices welded, polygons triangulated, and triangles reordered.
+	This is the same optimization the game performs when loading a mesh, so
+	running it offline only saves load time.
+*/
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <regex>
+#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+#include "meshdata.h"
+
+int main(int argc, char **argv){
+	if(argc < 2){
+		cerr << "Usage:" << endl << "\t" << *argv << " <file.mesh> [weld epsilon]" << endl;
+		return 0;
+	}
+
+	ifstream source(argv[1]);
+
+	if(!source){
+		cerr << "File not found: " << argv[1] << endl;
+		return 1;
+	}
+
+	stringstream text;
+	text << source.rdbuf();
+
+	MeshData md;
+	if(!md.parse(text.str().c_str())){
+		cerr << "Model parsing error in [" << argv[1] << "]" << endl;
+		return 2;
+	}
+
+	size_t verts_in = md.vertices.size(), polys_in = md.polygons.size();
+
+	md.optimize((argc > 2) ? atof(argv[2]) : MESHDATA_WELD_EPSILON);
+
+	cerr
+		<< verts_in << " vertices, " << polys_in << " polygons -> "
+		<< md.vertices.size() << " vertices, " << md.polygons.size() << " triangles" << endl;
+
+	md.write(cout, "optimized");
+
+	return 0;
+}
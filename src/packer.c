@@ -0,0 +1,124 @@
+/*
+	packer.c
+	mperron (2020)
+
+	Writes the files named in the arguments into an asset pack (see pak.h),
+	which the game can map at startup in place of its built in assets. Paths
+	are stored as given, less any leading "./".
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pak.h"
+
+#define READ_BLOCK_SIZE 4096
+
+typedef struct {
+	const char *path;
+	uint32_t hash;
+} pak_file;
+
+static int by_index_order(const void *a, const void *b){
+	const pak_file *fa = a, *fb = b;
+
+	return pak_compare(fa->hash, fa->path, fb->hash, fb->path);
+}
+
+static void pad(FILE *out, long to){
+	while(ftell(out) < to)
+		fputc(0, out);
+}
+
+static long align(long n){
+	return (n + PAK_ALIGN - 1) / PAK_ALIGN * PAK_ALIGN;
+}
+
+int main(int argc, char **argv){
+	char buffer[READ_BLOCK_SIZE];
+	size_t r;
+	int count = argc - 2, i;
+
+	if(argc < 2){
+		fprintf(stderr, "Usage:\n\t%s <pack> [file...]\n", *argv);
+		return 0;
+	}
+
+	pak_file *files = calloc(count + 1, sizeof(pak_file));
+	pak_entry *entries = calloc(count + 1, sizeof(pak_entry));
+
+	if(!files || !entries){
+		fprintf(stderr, "Failed to allocate the index!\n");
+		return 2;
+	}
+
+	for(i = 0; i < count; i++){
+		files[i].path = argv[i + 2];
+
+		if(!strncmp(files[i].path, "./", 2))
+			files[i].path += 2;
+
+		files[i].hash = pak_hash(files[i].path);
+	}
+
+	qsort(files, count, sizeof(pak_file), by_index_order);
+
+	FILE *out = fopen(argv[1], "wb");
+
+	if(!out){
+		fprintf(stderr, "Failed to open %s for writing!\n", argv[1]);
+		return 1;
+	}
+
+	pak_header header;
+
+	memcpy(header.magic, PAK_MAGIC, 4);
+	header.version = PAK_VERSION;
+	header.count = count;
+	header.reserved = 0;
+
+	// The index is written last, once the offsets are known.
+	fwrite(&header, sizeof(header), 1, out);
+	pad(out, sizeof(header) + count * sizeof(pak_entry));
+
+	for(i = 0; i < count; i++){
+		entries[i].hash = files[i].hash;
+		entries[i].name = ftell(out);
+		fwrite(files[i].path, 1, strlen(files[i].path) + 1, out);
+	}
+
+	for(i = 0; i < count; i++){
+		FILE *source = fopen(files[i].path, "rb");
+
+		if(!source){
+			fprintf(stderr, "File not found: %s\n", files[i].path);
+			return 1;
+		}
+
+		pad(out, align(ftell(out)));
+		entries[i].offset = ftell(out);
+		entries[i].size = 0;
+
+		while((r = fread(buffer, sizeof(char), READ_BLOCK_SIZE, source))){
+			fwrite(buffer, sizeof(char), r, out);
+			entries[i].size += r;
+		}
+
+		fclose(source);
+		fputc(0, out);
+	}
+
+	fseek(out, sizeof(header), SEEK_SET);
+	fwrite(entries, sizeof(pak_entry), count, out);
+
+	if(fclose(out)){
+		fprintf(stderr, "Failed to write %s!\n", argv[1]);
+		return 1;
+	}
+
+	free(files);
+	free(entries);
+
+	return 0;
+}
@@ -0,0 +1,52 @@
+/*
+	The layout of an asset pack, shared by the packer and the game.
+
+	A pack starts with a header, followed by an index of every file sorted
+	by the hash of its path (then by path), followed by the paths, and then
+	the file data. Every file's data starts on a PAK_ALIGN byte boundary and
+	is followed by a NUL, so text files can be used in place as C strings.
+	All numbers are little-endian.
+*/
+#ifndef QS_PAK_H
+#define QS_PAK_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define PAK_MAGIC "PGPK"
+#define PAK_VERSION 1
+#define PAK_ALIGN 16
+
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+} pak_header;
+
+typedef struct {
+	uint32_t hash;   // pak_hash of the path
+	uint32_t name;   // offset of the NUL terminated path
+	uint64_t offset; // offset of the data
+	uint64_t size;   // size of the data, not counting its NUL
+} pak_entry;
+
+// FNV-1a hash of a path.
+static inline uint32_t pak_hash(const char *path){
+	uint32_t h = 2166136261u;
+
+	while(*path)
+		h = (h ^ (uint8_t) *(path++)) * 16777619u;
+
+	return h;
+}
+
+// Index order: by hash, then by path.
+static inline int pak_compare(uint32_t hash_a, const char *path_a, uint32_t hash_b, const char *path_b){
+	if(hash_a != hash_b)
+		return ((hash_a < hash_b) ? -1 : 1);
+
+	return strcmp(path_a, path_b);
+}
+
+#endif
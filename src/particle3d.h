@@ -0,0 +1,158 @@
+/*
+	ParticleEffect3D
+	mperron (2020)
+
+	A base class for particle effects which live in a Scene3D's world. The
+	state of every particle is kept in flat arrays, one per field, and each
+	frame goes through three passes over them: the effect's update, then a
+	projection of every particle to the screen, then a splat of each visible
+	particle into the camera's frame buffer, tested against its depth buffer.
+*/
+class ParticleEffect3D : public Scene3D::Renderable {
+	// Projected particles, rebuilt every frame.
+	vector<int> screen_x, screen_y, screen_size;
+	vector<float> screen_depth;
+	vector<int> visible;
+
+	// Arctangent accurate to about 2e-4 radians, which is a small fraction
+	// of a pixel, and cheap enough to run for every particle.
+	static inline float fast_atan2(const float &y, const float &x){
+		float ax = fabsf(x), ay = fabsf(y);
+		float a = min(ax, ay) / (max(ax, ay) + 1e-30f);
+		float s = a * a;
+		float r = ((-0.0464964749f * s + 0.15931422f) * s - 0.327622764f) * s * a + a;
+
+		if(ay > ax)
+			r = 1.57079637f - r;
+		if(x < 0)
+			r = 3.14159274f - r;
+
+		return ((y < 0) ? -r : r);
+	}
+
+	static inline float wrap(float angle){
+		if(angle > (float) PI)
+			angle -= (float)(2 * PI);
+		else if(angle < (float) -PI)
+			angle += (float)(2 * PI);
+
+		return angle;
+	}
+
+	// Find the pixel, depth and splat size of every particle, using the
+	// same angular mapping as Camera::vertex_screenspace.
+	void project(){
+		const int count = pos_x.size();
+		const float cx = cam->pos.x, cy = cam->pos.y, cz = cam->pos.z;
+		const float point_xz = cam->point_xz.getValue(), point_y = cam->point_y.getValue();
+		const float scale_x = cam->w / (2 * cam->maxangle_w), scale_y = cam->h / (2 * cam->maxangle_h);
+		const float size_scale = size * scale_x;
+
+		screen_x.resize(count);
+		screen_y.resize(count);
+		screen_size.resize(count);
+		screen_depth.resize(count);
+		visible.clear();
+
+		for(int i = 0; i < count; i++){
+			float dx = pos_x[i] - cx, dy = pos_y[i] - cy, dz = pos_z[i] - cz;
+			float flat = sqrtf(dx * dx + dz * dz);
+			float depth = sqrtf(flat * flat + dy * dy);
+			float yaw = wrap(fast_atan2(dz, dx) - point_xz);
+			float pitch = wrap(fast_atan2(dy, flat) - point_y);
+
+			screen_x[i] = cam->w - (int)((cam->w / 2) + yaw * scale_x);
+			screen_y[i] = cam->h - (int)((cam->h / 2) + pitch * scale_y);
+			screen_depth[i] = depth;
+
+			int s = (int)(size_scale / (depth + 1e-6f));
+			screen_size[i] = ((s < 1) ? 1 : ((s > 4) ? 4 : s));
+		}
+
+		for(int i = 0; i < count; i++)
+			if(
+				(screen_x[i] >= 0) && (screen_x[i] < cam->w) &&
+				(screen_y[i] >= 0) && (screen_y[i] < cam->h) &&
+				(screen_depth[i] < MAX_DRAW_DISTANCE)
+			)
+				visible.push_back(i);
+	}
+
+	// Draw each visible particle as a small square, writing both color and
+	// depth so later passes see it.
+	void splat(){
+		const bool indexed = cam->indexed;
+		const int w = cam->w, h = cam->h;
+
+		for(int i : visible){
+			const int s = screen_size[i];
+			const int x0 = max(0, screen_x[i] - s / 2), x1 = min(w, screen_x[i] - s / 2 + s);
+			const int y0 = max(0, screen_y[i] - s / 2), y1 = min(h, screen_y[i] - s / 2 + s);
+			const double depth = screen_depth[i];
+			const byte_t color_ix = (indexed ? Scene3D::Camera::quantize(color[i]) : 0);
+
+			for(int y = y0; y < y1; y++){
+				for(int x = x0; x < x1; x++){
+					const int offset = (w * y + x);
+
+					if(depth >= cam->screenspace_zb[offset])
+						continue;
+
+					if(indexed)
+						cam->screenspace_ix[offset] = color_ix;
+					else
+						memcpy(&cam->screenspace_px[offset * 4], &color[i], 4);
+
+					cam->screenspace_zb[offset] = depth;
+				}
+			}
+		}
+	}
+
+protected:
+	// Position, velocity and BGRA color of each particle.
+	vector<float> pos_x, pos_y, pos_z;
+	vector<float> vel_x, vel_y, vel_z;
+	vector<uint32_t> color;
+
+	// World size of a particle, which sets its splat size on screen.
+	float size;
+
+	ParticleEffect3D(Scene3D::Camera *cam, const int &count, const float &size) :
+		Scene3D::Renderable(cam),
+		pos_x(count), pos_y(count), pos_z(count),
+		vel_x(count), vel_y(count), vel_z(count),
+		color(count)
+	{
+		this->size = size;
+	}
+
+	// Set a particle's color.
+	void set_color(const int &i, const uint32_t &argb){
+		color[i] = argb;
+	}
+
+	// Move every particle along its velocity. Effects can call this from
+	// update, before or after their own adjustments.
+	void integrate(const float &time){
+		const int count = pos_x.size();
+
+		for(int i = 0; i < count; i++){
+			pos_x[i] += vel_x[i] * time;
+			pos_y[i] += vel_y[i] * time;
+			pos_z[i] += vel_z[i] * time;
+		}
+	}
+
+public:
+	// Advance the simulation by some seconds.
+	virtual void update(float time) = 0;
+
+	virtual void draw(int ticks){
+		update(ticks / 1000.0f);
+		project();
+		splat();
+	}
+
+	virtual ~ParticleEffect3D(){}
+};
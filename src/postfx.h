@@ -0,0 +1,309 @@
+/*
+	PostChain
+	mperron (2020)
+
+	Post-processing effects for the software frame buffer. Each pass works
+	on 32-bit BGRA pixels (with the matching depth buffer available), and
+	the chain runs every pass over one band of rows before moving on to the
+	next, so that the whole chain costs a single trip through memory.
+*/
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#define POSTFX_BAND_ROWS 8
+
+class PostPass {
+public:
+	const char *name;
+	bool enabled = true;
+
+	PostPass(const char *name){
+		this->name = name;
+	}
+
+	// Process rows [y0, y1) of a w pixel wide frame. px and zb point at the
+	// start of the whole frame.
+	virtual void run(uint8_t *px, const double *zb, int w, int y0, int y1) = 0;
+
+	virtual ~PostPass(){}
+};
+
+// Ordered dithering down to a limited number of bits per channel.
+class DitherPass : public PostPass {
+	uint8_t mask;
+	uint8_t offsets[4][16];
+
+public:
+	DitherPass(int bits = 5) : PostPass("dither") {
+		static const int bayer[4][4] = {
+			{  0,  8,  2, 10 },
+			{ 12,  4, 14,  6 },
+			{  3, 11,  1,  9 },
+			{ 15,  7, 13,  5 }
+		};
+		const int step = 1 << (8 - bits);
+
+		mask = (uint8_t)(0xff << (8 - bits));
+
+		// One row of four pixels of threshold offsets per Bayer row, with
+		// alpha left alone.
+		for(int y = 0; y < 4; y++)
+			for(int x = 0; x < 4; x++)
+				for(int c = 0; c < 4; c++)
+					offsets[y][x * 4 + c] = ((c == 3) ? 0 : (bayer[y][x] * step / 16));
+	}
+
+	void run(uint8_t *px, const double *zb, int w, int y0, int y1){
+		for(int y = y0; y < y1; y++){
+			uint8_t *row = px + y * w * 4;
+			const uint8_t *offs = offsets[y & 3];
+			int i = 0;
+
+#ifdef __SSE2__
+			const __m128i voffs = _mm_loadu_si128((const __m128i*) offs);
+			const __m128i vmask = _mm_set1_epi32((int)(0xff000000 | (mask << 16) | (mask << 8) | mask));
+
+			for(; i + 16 <= w * 4; i += 16){
+				__m128i p = _mm_loadu_si128((__m128i*)(row + i));
+
+				_mm_storeu_si128((__m128i*)(row + i), _mm_and_si128(_mm_adds_epu8(p, voffs), vmask));
+			}
+#endif
+
+			for(; i < w * 4; i++){
+				if((i & 3) == 3)
+					continue;
+
+				int v = row[i] + offs[i & 15];
+				row[i] = ((v > 0xff) ? 0xff : v) & mask;
+			}
+		}
+	}
+};
+
+// Blend toward a fog color with distance, read from the depth buffer.
+class FogPass : public PostPass {
+	uint8_t color[4];
+	float start, end, density;
+
+public:
+	FogPass(uint8_t r, uint8_t g, uint8_t b, float start, float end, float density = 1.0f) : PostPass("fog") {
+		color[0] = b;
+		color[1] = g;
+		color[2] = r;
+		color[3] = 0xff;
+
+		this->start = start;
+		this->end = end;
+		this->density = ((density > 1.0f) ? 1.0f : density);
+	}
+
+	void run(uint8_t *px, const double *zb, int w, int y0, int y1){
+		// Weights run from 0 to 128 so (fog - p) * weight fits in 16 bits.
+		const float scale = density * 128.0f / (end - start);
+		const float limit = density * 128.0f;
+
+		for(int y = y0; y < y1; y++){
+			uint8_t *row = px + y * w * 4;
+			const double *depth = zb + y * w;
+			int x = 0;
+
+#ifdef __SSE2__
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i fog = _mm_set_epi16(color[3], color[2], color[1], color[0], color[3], color[2], color[1], color[0]);
+			const __m128 vstart = _mm_set1_ps(start), vscale = _mm_set1_ps(scale);
+			const __m128 vmax = _mm_set1_ps(limit);
+			const __m128i color_lanes = _mm_set_epi16(0, -1, -1, -1, 0, -1, -1, -1);
+
+			for(; x + 4 <= w; x += 4){
+				// Four fog weights, one per pixel.
+				__m128 d = _mm_movelh_ps(_mm_cvtpd_ps(_mm_loadu_pd(depth + x)), _mm_cvtpd_ps(_mm_loadu_pd(depth + x + 2)));
+				__m128 f = _mm_min_ps(_mm_max_ps(_mm_mul_ps(_mm_sub_ps(d, vstart), vscale), _mm_setzero_ps()), vmax);
+				__m128i fi = _mm_cvtps_epi32(f);
+
+				// Spread each weight across its pixel's four 16-bit lanes.
+				__m128i f16 = _mm_packs_epi32(fi, fi);
+				__m128i f2 = _mm_unpacklo_epi16(f16, f16);
+				__m128i w_lo = _mm_and_si128(_mm_unpacklo_epi32(f2, f2), color_lanes);
+				__m128i w_hi = _mm_and_si128(_mm_unpackhi_epi32(f2, f2), color_lanes);
+
+				__m128i p = _mm_loadu_si128((__m128i*)(row + x * 4));
+				__m128i lo = _mm_unpacklo_epi8(p, zero);
+				__m128i hi = _mm_unpackhi_epi8(p, zero);
+
+				// p + (fog - p) * f / 128
+				lo = _mm_add_epi16(lo, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(fog, lo), w_lo), 7));
+				hi = _mm_add_epi16(hi, _mm_srai_epi16(_mm_mullo_epi16(_mm_sub_epi16(fog, hi), w_hi), 7));
+
+				_mm_storeu_si128((__m128i*)(row + x * 4), _mm_packus_epi16(lo, hi));
+			}
+#endif
+
+			for(; x < w; x++){
+				float f = (depth[x] - start) * scale;
+				int weight = (int)((f < 0) ? 0 : ((f > limit) ? limit : (f + 0.5f)));
+				uint8_t *p = row + x * 4;
+
+				for(int c = 0; c < 3; c++)
+					p[c] = p[c] + (((color[c] - p[c]) * weight) >> 7);
+			}
+		}
+	}
+};
+
+// Darken every other row, like the gaps between the lines of a CRT.
+class ScanlinePass : public PostPass {
+	uint16_t brightness;
+
+public:
+	ScanlinePass(float brightness = 0.75f) : PostPass("scanlines") {
+		this->brightness = (uint16_t)(brightness * 256);
+	}
+
+	void run(uint8_t *px, const double *zb, int w, int y0, int y1){
+		for(int y = y0 | 1; y < y1; y += 2){
+			uint8_t *row = px + y * w * 4;
+			int i = 0;
+
+#ifdef __SSE2__
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i scale = _mm_set_epi16(256, brightness, brightness, brightness, 256, brightness, brightness, brightness);
+
+			for(; i + 16 <= w * 4; i += 16){
+				__m128i p = _mm_loadu_si128((__m128i*)(row + i));
+				__m128i lo = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(p, zero), scale), 8);
+				__m128i hi = _mm_srli_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(p, zero), scale), 8);
+
+				_mm_storeu_si128((__m128i*)(row + i), _mm_packus_epi16(lo, hi));
+			}
+#endif
+
+			for(; i < w * 4; i++)
+				if((i & 3) != 3)
+					row[i] = (row[i] * brightness) >> 8;
+		}
+	}
+};
+
+// Per-channel gain and lift: out = in * gain + lift. Gains are 8.8 fixed
+// point and must stay under 4.0.
+class GradePass : public PostPass {
+	uint16_t gain[4];
+	int16_t lift[4];
+
+	static uint16_t fixed(float gain){
+		return (uint16_t)((gain < 0) ? 0 : ((gain > 3.99f) ? (3.99f * 256) : (gain * 256)));
+	}
+
+public:
+	GradePass(float gain_r, float gain_g, float gain_b, int lift_r = 0, int lift_g = 0, int lift_b = 0) : PostPass("grade") {
+		gain[0] = fixed(gain_b);
+		gain[1] = fixed(gain_g);
+		gain[2] = fixed(gain_r);
+		gain[3] = 256;
+
+		lift[0] = lift_b;
+		lift[1] = lift_g;
+		lift[2] = lift_r;
+		lift[3] = 0;
+	}
+
+	void run(uint8_t *px, const double *zb, int w, int y0, int y1){
+		for(int y = y0; y < y1; y++){
+			uint8_t *row = px + y * w * 4;
+			int i = 0;
+
+#ifdef __SSE2__
+			// Widening with the pixel in the high byte makes mulhi give
+			// (p * gain) >> 8 directly.
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i vgain = _mm_set_epi16(gain[3], gain[2], gain[1], gain[0], gain[3], gain[2], gain[1], gain[0]);
+			const __m128i vlift = _mm_set_epi16(lift[3], lift[2], lift[1], lift[0], lift[3], lift[2], lift[1], lift[0]);
+
+			for(; i + 16 <= w * 4; i += 16){
+				__m128i p = _mm_loadu_si128((__m128i*)(row + i));
+				__m128i lo = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpacklo_epi8(zero, p), vgain), vlift);
+				__m128i hi = _mm_add_epi16(_mm_mulhi_epu16(_mm_unpackhi_epi8(zero, p), vgain), vlift);
+
+				_mm_storeu_si128((__m128i*)(row + i), _mm_packus_epi16(lo, hi));
+			}
+#endif
+
+			for(; i < w * 4; i++){
+				int v = ((row[i] * gain[i & 3]) >> 8) + lift[i & 3];
+
+				row[i] = ((v < 0) ? 0 : ((v > 0xff) ? 0xff : v));
+			}
+		}
+	}
+};
+
+class PostChain {
+	list<PostPass*> passes;
+	map<PostPass*, Uint64> ticks;
+
+public:
+	// Called after each frame with every enabled pass's name and the time
+	// it took, in milliseconds.
+	void (*timing_hook)(const char *pass, double ms) = NULL;
+
+	PostChain(){}
+	PostChain(const PostChain&) = delete;
+
+	~PostChain(){
+		for(PostPass *pass : passes)
+			delete pass;
+	}
+
+	// Add a pass to the end of the chain. The chain takes ownership.
+	PostPass *add(PostPass *pass){
+		passes.push_back(pass);
+
+		return pass;
+	}
+
+	void set_enabled(const bool &enabled){
+		for(PostPass *pass : passes)
+			pass->enabled = enabled;
+	}
+
+	// True when no enabled passes are left to run.
+	bool empty() const {
+		for(PostPass *pass : passes)
+			if(pass->enabled)
+				return false;
+
+		return true;
+	}
+
+	void run(uint8_t *px, const double *zb, int w, int h){
+		for(PostPass *pass : passes)
+			ticks[pass] = 0;
+
+		// Run the chain band by band, so each band is still in cache when
+		// the next pass gets to it.
+		for(int y0 = 0; y0 < h; y0 += POSTFX_BAND_ROWS){
+			int y1 = ((y0 + POSTFX_BAND_ROWS < h) ? (y0 + POSTFX_BAND_ROWS) : h);
+
+			for(PostPass *pass : passes){
+				if(!pass->enabled)
+					continue;
+
+				if(timing_hook){
+					Uint64 start = SDL_GetPerformanceCounter();
+
+					pass->run(px, zb, w, y0, y1);
+					ticks[pass] += SDL_GetPerformanceCounter() - start;
+				} else {
+					pass->run(px, zb, w, y0, y1);
+				}
+			}
+		}
+
+		if(timing_hook)
+			for(PostPass *pass : passes)
+				if(pass->enabled)
+					timing_hook(pass->name, ticks[pass] * 1000.0 / SDL_GetPerformanceFrequency());
+	}
+};
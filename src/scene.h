@@ -14,8 +14,7 @@ protected:
 
 public:
 	virtual ~Scene(){
-		if(bg)
-			SDL_DestroyTexture(bg);
+		textureRelease(bg);
 	}
 
 	virtual void draw(int ticks){
@@ -36,10 +35,11 @@ public:
 
 	class Controller : public Drawable {
 		Scene *scene_next = NULL;
+		string scene_pending;
 		map<int, bool> *keys = NULL;
 		list<Scene*> scene_stack;
 
-		SDL_Texture *mouse_tx, *mouse_tx_default;
+		TextureRef *mouse_tx, *mouse_tx_default;
 
 		int volume = 128;
 
@@ -62,12 +62,11 @@ public:
 
 			// Mouse cursor is a 14x14 pixel image.
 			mouse_cursor = { SCREEN_WIDTH, SCREEN_HEIGHT, 14, 14 };
-			mouse_tx_default = mouse_tx = textureFromBmp(rend, "mouse/cursor.bmp", true);
+			mouse_tx_default = mouse_tx = new TextureRef(rend, asset::mouse_cursor_bmp, true);
 		}
 
 		~Controller(){
-			if(mouse_tx_default)
-				SDL_DestroyTexture(mouse_tx);
+			delete mouse_tx_default;
 		}
 
 		SDL_Renderer *renderer(){
@@ -76,6 +75,15 @@ public:
 
 		void set_scene(Scene *scene){
 			this->scene_next = scene;
+			scene_pending.clear();
+		}
+
+		// Preload a scene by name, and swap to it on the first frame after
+		// it's ready. The current scene carries on drawing until then.
+		void set_scene(string name){
+			scene_pending = name;
+
+			Scene::preload(name);
 		}
 
 		// Save the current scene onto the scene stack and descend into a new sub-scene.
@@ -101,6 +109,11 @@ public:
 		}
 
 		void draw(int ticks){
+			if(!scene_pending.empty() && Scene::preloaded(scene_pending)){
+				scene_next = Scene::create(this, scene_pending);
+				scene_pending.clear();
+			}
+
 			if(scene_next){
 				if(scene){
 					bool scene_on_stack = false;
@@ -129,7 +142,7 @@ public:
 
 			// Draw mouse cursor
 			if(mouse_enabled && (SDL_GetRelativeMouseMode() != SDL_TRUE))
-				SDL_RenderCopy(rend, mouse_tx, NULL, &mouse_cursor);
+				mouse_tx->copy(rend, NULL, &mouse_cursor);
 		}
 
 		void quit(){
@@ -147,7 +160,7 @@ public:
 				scene->check_mouse(event);
 		}
 
-		void set_mouse_tx(SDL_Texture *mouse_tx){
+		void set_mouse_tx(TextureRef *mouse_tx){
 			this->mouse_tx = mouse_tx;
 		}
 		void clear_mouse_tx(){
@@ -177,33 +190,146 @@ protected:
 		this->ctrl = ctrl;
 	}
 
+	enum { PRELOAD_IDLE, PRELOAD_RUNNING, PRELOAD_READY };
+
 	class SceneFn {
 	public:
 		Scene* (*fn)(Scene::Controller*);
 
-		SceneFn(Scene* (*fn)(Scene::Controller*)){
+		// Assets the scene uses, which can be made ready ahead of time.
+		list<asset::id> assets;
+		SDL_atomic_t state;
+
+		// Thousandths of the preload done so far.
+		SDL_atomic_t progress;
+
+		SceneFn(Scene* (*fn)(Scene::Controller*), const list<asset::id> &assets){
 			this->fn = fn;
+			this->assets = assets;
+
+			SDL_AtomicSet(&state, PRELOAD_IDLE);
+			SDL_AtomicSet(&progress, 0);
 		}
 	};
 
 	static map<string, SceneFn*> scenes;
 
+	// Preparation for assets of a type which goes beyond decoding them, by
+	// file extension.
+	static map<string, void (*)(const string&)> preparers;
+
+	static int preload_thread(void *data);
+
 public:
-	static void reg(string, Scene* (*fn)(Controller*));
+	static void reg(string, Scene* (*fn)(Controller*), const list<asset::id> &assets = list<asset::id>());
+	static void prepare_with(string ext, void (*fn)(const string &fname));
+	static void preload(string);
+	static bool preloaded(string);
+	static float preload_progress(string);
 	static Scene *create(Controller *ctrl, string);
 };
 
 map<string, Scene::SceneFn*> Scene::scenes;
-void Scene::reg(string name, Scene* (*fn)(Scene::Controller*)){
-	scenes[name] = new Scene::SceneFn(fn);
+map<string, void (*)(const string&)> Scene::preparers;
+
+void Scene::reg(string name, Scene* (*fn)(Scene::Controller*), const list<asset::id> &assets){
+	scenes[name] = new Scene::SceneFn(fn, assets);
+}
+void Scene::prepare_with(string ext, void (*fn)(const string &fname)){
+	preparers[ext] = fn;
 }
+
+// Assets that only need decoding are prefetched together, so the work is
+// split across every core, and then the rest are prepared one at a time.
+int Scene::preload_thread(void *data){
+	Scene::SceneFn *fn = (Scene::SceneFn*) data;
+	list<string> fetch;
+	list<pair<void (*)(const string&), string> > prepare;
+
+	for(asset::id id : fn->assets){
+		string fname = FileLoader::name(id);
+		const AtlasRegion *region = FileLoader::in_pack(fname) ? NULL : atlas_find(fname.c_str());
+
+		// Bitmaps in an atlas are only embedded in their page.
+		if(region)
+			fname = atlas_page(region);
+
+		size_t dot = fname.rfind('.');
+		auto it = preparers.find((dot == string::npos) ? "" : fname.substr(dot));
+
+		if(it != preparers.end())
+			prepare.push_back(make_pair(it->second, fname));
+		else
+			fetch.push_back(fname);
+	}
+
+	// Progress is the prefetch's own when there's nothing else to do, and
+	// otherwise the prefetch and each preparer count as a step.
+	int steps = prepare.size() + (fetch.empty() ? 0 : 1), step = 0;
+
+	if(!fetch.empty()){
+		FileLoader::prefetch(fetch, prepare.empty() ? &fn->progress : NULL);
+		SDL_AtomicSet(&fn->progress, 1000 * ++step / steps);
+	}
+
+	for(auto &x : prepare){
+		x.first(x.second);
+		SDL_AtomicSet(&fn->progress, 1000 * ++step / steps);
+	}
+
+	SDL_AtomicSet(&fn->state, PRELOAD_READY);
+
+	return 0;
+}
+
+// Start getting a scene's assets ready on a background thread, so that
+// creating it later doesn't stall a frame. Only the scene's constructor
+// touches the renderer, so that part still happens in create.
+void Scene::preload(string name){
+	auto it = scenes.find(name);
+
+	if((it == scenes.end()) || !SDL_AtomicCAS(&it->second->state, PRELOAD_IDLE, PRELOAD_RUNNING))
+		return;
+
+	SDL_AtomicSet(&it->second->progress, 0);
+
+	SDL_Thread *thread = SDL_CreateThread(preload_thread, "scene preload", it->second);
+
+	if(thread)
+		SDL_DetachThread(thread);
+	else
+		preload_thread(it->second);
+}
+
+// Whether a scene is done preloading, or was never started. Scenes that
+// don't exist are never going to be any more ready than they are now.
+bool Scene::preloaded(string name){
+	auto it = scenes.find(name);
+
+	return ((it == scenes.end()) || (SDL_AtomicGet(&it->second->state) != PRELOAD_RUNNING));
+}
+
+// How much of a scene's preload is done, from 0 to 1. Scenes which aren't
+// preloading count as done, like in preloaded.
+float Scene::preload_progress(string name){
+	auto it = scenes.find(name);
+
+	if((it == scenes.end()) || (SDL_AtomicGet(&it->second->state) != PRELOAD_RUNNING))
+		return 1.0f;
+
+	return SDL_AtomicGet(&it->second->progress) / 1000.0f;
+}
+
 Scene *Scene::create(Scene::Controller *ctrl, string name){
-	Scene::SceneFn *fn = scenes[name];
+	auto it = scenes.find(name);
+
+	if(it == scenes.end())
+		return NULL;
 
-	if(fn)
-		return fn->fn(ctrl);
+	// Whatever was preloaded is used up, so preload again next time.
+	SDL_AtomicCAS(&it->second->state, PRELOAD_READY, PRELOAD_IDLE);
 
-	return NULL;
+	return it->second->fn(ctrl);
 }
 
 template<class T> Scene *scene_create(Scene::Controller *ctrl){
@@ -6,9 +6,168 @@
 #define SQUARE(x)          ((x) * (x))
 #define MAX_DRAW_DISTANCE  100.0
 #define MAX_CAM_PITCH      (PI / 4)
+#define ALPHA_SORT_BUCKETS 256
+#define TEXTURE_SPAN       8
+#define IMPOSTOR_SIZE      64
+#define IMPOSTOR_YAW_SLOTS 16
+#define IMPOSTOR_PITCH_SLOTS 4
+#define IMPOSTOR_THRESHOLD (PI / 32)
+#define VIS_FACE_BITS      32
+#define VIS_FACE_MASK      ((1ull << VIS_FACE_BITS) - 1)
+#define VIS_FACE_EDGE      VIS_FACE_MASK
+#define TERRAIN_CHUNK_CELLS 8
+#define TERRAIN_LOD_FACTOR 2.5
+#define COLLIDE_CELL       1.0
+#define COLLIDE_BUCKETS    4096
+#define COLLIDE_RADIUS     0.25
+#define COLLIDE_HEIGHT     1.0
+#define COLLIDE_STEP       0.3
+#define COLLIDE_ITERATIONS 4
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 
 typedef unsigned char byte_t;
 
+// Blend a solid BGRA color over a run of count pixels using the color's alpha
+// byte. The destination alpha is left opaque.
+static inline void blend_span(byte_t *dst, int count, const byte_t color[4]){
+	const int a = color[3], ia = 0xff - a;
+	int i = 0;
+
+#ifdef __SSE2__
+	// Four pixels at a time, widened to 16-bit lanes: dst * (255 - a) + src * a.
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i src = _mm_set_epi16(
+		0xff * a, color[2] * a, color[1] * a, color[0] * a,
+		0xff * a, color[2] * a, color[1] * a, color[0] * a
+	);
+	const __m128i inv = _mm_set1_epi16(ia);
+	const __m128i round = _mm_set1_epi16(0x80);
+
+	for(; i + 4 <= count; i += 4){
+		__m128i px = _mm_loadu_si128((__m128i*)(dst + i * 4));
+		__m128i lo = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpacklo_epi8(px, zero), inv), src), round);
+		__m128i hi = _mm_add_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_unpackhi_epi8(px, zero), inv), src), round);
+
+		// Divide by 255: (x + (x >> 8)) >> 8, with rounding already added.
+		lo = _mm_srli_epi16(_mm_add_epi16(lo, _mm_srli_epi16(lo, 8)), 8);
+		hi = _mm_srli_epi16(_mm_add_epi16(hi, _mm_srli_epi16(hi, 8)), 8);
+
+		_mm_storeu_si128((__m128i*)(dst + i * 4), _mm_packus_epi16(lo, hi));
+	}
+#endif
+
+	for(; i < count; i++){
+		byte_t *px = dst + i * 4;
+
+		for(int c = 0; c < 3; c++){
+			int x = px[c] * ia + color[c] * a + 0x80;
+
+			px[c] = (x + (x >> 8)) >> 8;
+		}
+		px[3] = 0xff;
+	}
+}
+
+// Convert a run of palette indices to ARGB pixels.
+static inline void palette_resolve(const byte_t *src, uint32_t *dst, int count, const uint32_t palette[256]){
+	int i = 0;
+
+#ifdef __AVX2__
+	// Widen eight indices to 32 bits and gather their colors in one go.
+	for(; i + 8 <= count; i += 8){
+		__m256i ix = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(src + i)));
+
+		_mm256_storeu_si256((__m256i*)(dst + i), _mm256_i32gather_epi32((const int*) palette, ix, 4));
+	}
+#endif
+
+	for(; i + 4 <= count; i += 4){
+		dst[i] = palette[src[i]];
+		dst[i + 1] = palette[src[i + 1]];
+		dst[i + 2] = palette[src[i + 2]];
+		dst[i + 3] = palette[src[i + 3]];
+	}
+	for(; i < count; i++)
+		dst[i] = palette[src[i]];
+}
+
+// Blend two arrays of quantized deltas and add them to a rest pose:
+// out = rest + (a + (b - a) * t) * scale, for count values.
+static inline void lerp_deltas(const int16_t *a, const int16_t *b, const double *rest, double *out, int count, float t, float scale){
+	int i = 0;
+
+#ifdef __SSE2__
+	const __m128 vt = _mm_set1_ps(t), vscale = _mm_set1_ps(scale);
+
+	for(; i + 8 <= count; i += 8){
+		__m128i va = _mm_loadu_si128((const __m128i*)(a + i));
+		__m128i vb = _mm_loadu_si128((const __m128i*)(b + i));
+
+		// Sign extend to 32 bits by unpacking each value into the high half
+		// and shifting it back down.
+		__m128 fa_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(va, va), 16));
+		__m128 fa_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(va, va), 16));
+		__m128 fb_lo = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(vb, vb), 16));
+		__m128 fb_hi = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(vb, vb), 16));
+
+		__m128 lo = _mm_mul_ps(_mm_add_ps(fa_lo, _mm_mul_ps(_mm_sub_ps(fb_lo, fa_lo), vt)), vscale);
+		__m128 hi = _mm_mul_ps(_mm_add_ps(fa_hi, _mm_mul_ps(_mm_sub_ps(fb_hi, fa_hi), vt)), vscale);
+
+		_mm_storeu_pd(out + i, _mm_add_pd(_mm_loadu_pd(rest + i), _mm_cvtps_pd(lo)));
+		_mm_storeu_pd(out + i + 2, _mm_add_pd(_mm_loadu_pd(rest + i + 2), _mm_cvtps_pd(_mm_movehl_ps(lo, lo))));
+		_mm_storeu_pd(out + i + 4, _mm_add_pd(_mm_loadu_pd(rest + i + 4), _mm_cvtps_pd(hi)));
+		_mm_storeu_pd(out + i + 6, _mm_add_pd(_mm_loadu_pd(rest + i + 6), _mm_cvtps_pd(_mm_movehl_ps(hi, hi))));
+	}
+#endif
+
+	for(; i < count; i++)
+		out[i] = rest[i] + (a[i] + (b[i] - a[i]) * t) * scale;
+}
+
+// Expand 16-bit quantized x,y,z triples: out = origin + q * step, with the
+// axis of each value given by its position mod 3, for count values.
+static inline void dequantize(const int16_t *src, double *dst, int count, const double origin[3], const double step[3]){
+	int i = 0;
+
+#ifdef __SSE2__
+	// Pairs of outputs cycle through x,y then z,x then y,z.
+	const __m128d o[3] = {
+		_mm_set_pd(origin[1], origin[0]), _mm_set_pd(origin[0], origin[2]), _mm_set_pd(origin[2], origin[1])
+	};
+	const __m128d s[3] = {
+		_mm_set_pd(step[1], step[0]), _mm_set_pd(step[0], step[2]), _mm_set_pd(step[2], step[1])
+	};
+
+	// 24 values, or 8 vertices, at a time so the pattern starts over.
+	for(; i + 24 <= count; i += 24){
+		for(int k = 0; k < 3; k++){
+			__m128i v = _mm_loadu_si128((const __m128i*)(src + i + 8 * k));
+			__m128i lo = _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16);
+			__m128i hi = _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16);
+			const __m128d d[4] = {
+				_mm_cvtepi32_pd(lo), _mm_cvtepi32_pd(_mm_srli_si128(lo, 8)),
+				_mm_cvtepi32_pd(hi), _mm_cvtepi32_pd(_mm_srli_si128(hi, 8))
+			};
+
+			for(int j = 0; j < 4; j++){
+				int pair = 4 * k + j;
+
+				_mm_storeu_pd(dst + i + 2 * pair, _mm_add_pd(o[pair % 3], _mm_mul_pd(d[j], s[pair % 3])));
+			}
+		}
+	}
+#endif
+
+	for(; i < count; i++)
+		dst[i] = origin[i % 3] + src[i] * step[i % 3];
+}
+
 class Scene3D : public Scene {
 
 public:
@@ -184,9 +343,50 @@ public:
 		}
 	};
 
+	class Collider;
+	struct Clip;
+
 	class Camera : public Clickable {
 		bool mlook_active = false;
 
+		// The palette used by indexed cameras, and a table mapping every
+		// 15-bit RGB color to its nearest palette entry. Until a palette is
+		// set, a 3-3-2 bit RGB palette is used. The table is only built once
+		// a camera is made indexed, on the main thread, and is only read while
+		// drawing for an indexed camera.
+		static uint32_t palette[256];
+		static byte_t palette_lookup[1 << 15];
+		static bool palette_lookup_ready, palette_custom;
+
+		static void build_palette_lookup(){
+			if(!palette_custom)
+				for(int i = 0; i < 256; i++)
+					palette[i] = 0xff000000 | (((i >> 5) * 0xff / 7) << 16) | ((((i >> 2) & 7) * 0xff / 7) << 8) | ((i & 3) * 0xff / 3);
+
+			for(int rgb = 0; rgb < (1 << 15); rgb++){
+				int r = ((rgb >> 10) & 0x1f) * 0xff / 0x1f;
+				int g = ((rgb >> 5) & 0x1f) * 0xff / 0x1f;
+				int b = (rgb & 0x1f) * 0xff / 0x1f;
+				int best = 0, best_distance = 3 * 0x10000;
+
+				for(int i = 0; (i < 256) && best_distance; i++){
+					int distance =
+						SQUARE(r - (int)((palette[i] >> 16) & 0xff)) +
+						SQUARE(g - (int)((palette[i] >> 8) & 0xff)) +
+						SQUARE(b - (int)(palette[i] & 0xff));
+
+					if(distance < best_distance){
+						best_distance = distance;
+						best = i;
+					}
+				}
+
+				palette_lookup[rgb] = best;
+			}
+
+			palette_lookup_ready = true;
+		}
+
 	public:
 		coord pos, point;
 		Radian point_xz = 0, point_y = 0;
@@ -200,12 +400,80 @@ public:
 
 		bool wireframe = false;
 
-		Camera(SDL_Renderer *rend, coord pos, coord point, int w, int h, double maxangle) :
+		// Geometry to walk against, if any.
+		Collider *collider = NULL;
+
+		// In indexed mode the rasterizer writes a palette index per pixel to
+		// screenspace_ix instead of BGRA to screenspace_px. Indices are
+		// turned into colors while the frame is uploaded.
+		bool indexed = false;
+		vector<byte_t> screenspace_ix;
+
+		// Post-processing passes run over the finished frame before upload.
+		PostChain post;
+
+		// In deferred mode opaque faces only write depth and an id to
+		// screenspace_id, and Scene3D resolves each pixel's color once the
+		// whole scene is rasterized. An id holds the mesh's slot for the
+		// frame (plus one) above VIS_FACE_BITS, and the face index below.
+		// Zero is no face, and VIS_FACE_EDGE marks a face border. Ids are 64
+		// bits so that neither half can run into the other: no scene draws
+		// four billion meshes, or has a mesh with that many faces.
+		bool deferred = false;
+		vector<uint64_t> screenspace_id;
+
+		void set_deferred(const bool &deferred){
+			this->deferred = deferred;
+
+			if(deferred)
+				screenspace_id.assign(w * h, 0);
+			else
+				screenspace_id.clear();
+		}
+
+		void set_indexed(const bool &indexed){
+			this->indexed = indexed;
+
+			if(indexed){
+				if(!palette_lookup_ready)
+					build_palette_lookup();
+
+				screenspace_ix.assign(w * h, 0);
+			} else {
+				screenspace_ix.clear();
+			}
+		}
+
+		// Replace the palette. The nearest-color table is kept, so colors
+		// keep their indices and this alone swaps colors. With requantize
+		// set, the table is rebuilt for the new palette. If no camera has
+		// been indexed yet, the table is built from this palette when one is.
+		static void set_palette(const uint32_t colors[256], const bool &requantize = false){
+			memcpy(palette, colors, sizeof(palette));
+			palette_custom = true;
+
+			if(requantize && palette_lookup_ready)
+				build_palette_lookup();
+		}
+
+		// Nearest palette index for a BGRA color. Only valid once a camera
+		// has been made indexed.
+		static inline byte_t quantize(const byte_t bgra[4]){
+			return palette_lookup[((bgra[2] >> 3) << 10) | ((bgra[1] >> 3) << 5) | (bgra[0] >> 3)];
+		}
+		static inline byte_t quantize(const uint32_t &argb){
+			return palette_lookup[((argb >> 9) & 0x7c00) | ((argb >> 6) & 0x3e0) | ((argb >> 3) & 0x1f)];
+		}
+
+		// A headless camera renders into its buffers, but has no texture to
+		// upload them to, so draw_frame must not be called on it.
+		Camera(coord pos, coord point, int w, int h, double maxangle) :
 			Clickable(),
-			screenspace_px(SCREEN_WIDTH * SCREEN_HEIGHT * 4, 0),
-			screenspace_zb(SCREEN_WIDTH * SCREEN_HEIGHT, MAX_DRAW_DISTANCE)
+			screenspace_px(w * h * 4, 0),
+			screenspace_zb(w * h, MAX_DRAW_DISTANCE)
 		{
-			this->rend = rend;
+			this->rend = NULL;
+			this->screenspace_tx = NULL;
 			this->pos = pos;
 			this->point = point;
 			this->w = w;
@@ -219,12 +487,18 @@ public:
 				maxangle_w = maxangle_w / h * w;
 			}
 
-			screenspace_tx = SDL_CreateTexture(rend, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, SCREEN_WIDTH, SCREEN_HEIGHT);
 			cache();
 		}
+		Camera(SDL_Renderer *rend, coord pos, coord point, int w, int h, double maxangle) :
+			Camera(pos, point, w, h, maxangle)
+		{
+			this->rend = rend;
+			screenspace_tx = SDL_CreateTexture(rend, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, w, h);
+		}
 
 		~Camera(){
-			SDL_DestroyTexture(screenspace_tx);
+			if(screenspace_tx)
+				SDL_DestroyTexture(screenspace_tx);
 		}
 
 		// Get the x,y coordinates of a pixel on screen to represent this visible vertex.
@@ -250,6 +524,22 @@ public:
 			return false;
 		}
 
+		// Whether any of a sphere is within the camera's view angles.
+		bool sphere_visible(const coord &center, const double &radius) const {
+			coord rel = center - pos;
+			double distance = pos.distance_to(center);
+
+			if(distance <= radius)
+				return true;
+
+			double spread = asin(min(1.0, radius / distance));
+
+			return (
+				(abs(rel.angle_xz() - point_xz) <= (maxangle_w + spread)) &&
+				(abs(rel.angle_y() - point_y) <= (maxangle_h + spread))
+			);
+		}
+
 		// Turn the camera the specified number of radians around the Y-axis.
 		void yaw(const double &delta){
 			double xz = point_xz + delta;
@@ -276,8 +566,13 @@ public:
 
 		void walk(const double &distance){
 			double heading = point_xz.getValue();
+			coord delta = { distance * cos(heading), 0, distance * sin(heading) };
+
+			if(collider)
+				pos = collider->move(pos, delta);
+			else
+				pos += delta;
 
-			pos += (coord){ distance * cos(heading), 0, distance * sin(heading) };
 			cache();
 		}
 
@@ -309,19 +604,53 @@ public:
 		}
 
 		void draw_frame(){
-			// Update the screen texture and draw it.
-			SDL_UpdateTexture(screenspace_tx, NULL, &screenspace_px[0], SCREEN_WIDTH * 4);
+			// Update the screen texture and draw it. Indexed frames are
+			// resolved through the palette straight into the texture, unless
+			// there are post-processing passes to run on the colors first.
+			if(!post.empty()){
+				if(indexed)
+					palette_resolve(&screenspace_ix[0], (uint32_t*) &screenspace_px[0], w * h, palette);
+
+				post.run(&screenspace_px[0], &screenspace_zb[0], w, h);
+				SDL_UpdateTexture(screenspace_tx, NULL, &screenspace_px[0], w * 4);
+			} else if(indexed){
+				void *pixels;
+				int pitch;
+
+				if(!SDL_LockTexture(screenspace_tx, NULL, &pixels, &pitch)){
+					for(int y = 0; y < h; y++)
+						palette_resolve(&screenspace_ix[w * y], (uint32_t*)((byte_t*) pixels + y * pitch), w, palette);
+
+					SDL_UnlockTexture(screenspace_tx);
+				}
+			} else {
+				SDL_UpdateTexture(screenspace_tx, NULL, &screenspace_px[0], w * 4);
+			}
 			SDL_RenderCopy(rend, screenspace_tx, NULL, NULL);
 
 			// Set the entire screen buffer to a background color.
 			const byte_t fill[4] = { 0x10, 0x29, 0xad, 0xff }; // BGRA
-			for(int i = 0; i < (4 * SCREEN_WIDTH * SCREEN_HEIGHT); i++){
+			clear(fill);
+		}
+
+		// Fill the frame buffer with a BGRA color, and reset the depth buffer.
+		void clear(const byte_t fill[4]){
+			if(deferred)
+				memset(&screenspace_id[0], 0, w * h * sizeof(uint64_t));
+
+			if(indexed){
+				memset(&screenspace_ix[0], quantize(fill), w * h);
+				fill_n(screenspace_zb.begin(), w * h, MAX_DRAW_DISTANCE);
+
+				return;
+			}
+
+			for(int i = 0; i < (4 * w * h); i++){
 				screenspace_px[i] = fill[i % 4];
 
 				if(!(i % 4))
 					screenspace_zb[i / 4] = MAX_DRAW_DISTANCE;
 			}
-
 		}
 
 		void cache(){
@@ -330,6 +659,153 @@ public:
 		}
 	} *cam;
 
+	// An image which can be mapped onto mesh faces, loaded from a BMP asset.
+	// The image is resampled to power-of-two dimensions, and a full chain of
+	// mip levels is built at load time. Each level is stored as 4x4 tiles of
+	// texels, so texels which are close together on screen are usually in
+	// the same 64-byte cache line.
+	class Texture {
+		static map<string, Texture*> textures;
+		static SDL_mutex *textures_lock;
+
+		struct Level {
+			int w, h, tiles_w;
+			vector<uint32_t> texels;
+
+			Level(int w, int h) :
+				texels(((w + 3) / 4) * ((h + 3) / 4) * 16, 0)
+			{
+				this->w = w;
+				this->h = h;
+				this->tiles_w = (w + 3) / 4;
+			}
+
+			inline uint32_t &at(const int &x, const int &y){
+				return texels[(((y >> 2) * tiles_w + (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3)];
+			}
+			inline const uint32_t &at(const int &x, const int &y) const {
+				return texels[(((y >> 2) * tiles_w + (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3)];
+			}
+		};
+
+		vector<Level> levels;
+
+		static int pow2_ceil(int x){
+			int p = 1;
+
+			while(p < x)
+				p <<= 1;
+
+			return p;
+		}
+
+		Texture(SDL_Surface *sf){
+			SDL_Surface *conv = SDL_ConvertSurfaceFormat(sf, SDL_PIXELFORMAT_ARGB8888, 0);
+			int w = pow2_ceil(conv->w), h = pow2_ceil(conv->h);
+
+			// Copy the image into the first level, resampling to the nearest
+			// texel if the dimensions weren't powers of two.
+			levels.push_back(Level(w, h));
+			SDL_LockSurface(conv);
+			for(int y = 0; y < h; y++){
+				const uint32_t *row = (const uint32_t*)((byte_t*) conv->pixels + (y * conv->h / h) * conv->pitch);
+
+				for(int x = 0; x < w; x++)
+					levels[0].at(x, y) = row[x * conv->w / w];
+			}
+			SDL_UnlockSurface(conv);
+			SDL_FreeSurface(conv);
+
+			// Build each mip level by averaging 2x2 blocks of the previous one.
+			while((w > 1) || (h > 1)){
+				const Level &prev = levels.back();
+				int pw = w, ph = h;
+
+				w = ((w > 1) ? (w / 2) : 1);
+				h = ((h > 1) ? (h / 2) : 1);
+
+				Level next(w, h);
+				for(int y = 0; y < h; y++){
+					for(int x = 0; x < w; x++){
+						const uint32_t quad[4] = {
+							prev.at((2 * x) % pw, (2 * y) % ph),
+							prev.at((2 * x + 1) % pw, (2 * y) % ph),
+							prev.at((2 * x) % pw, (2 * y + 1) % ph),
+							prev.at((2 * x + 1) % pw, (2 * y + 1) % ph)
+						};
+						uint32_t texel = 0;
+
+						for(int shift = 0; shift < 32; shift += 8){
+							uint32_t sum = 2;
+
+							for(int i = 0; i < 4; i++)
+								sum += (quad[i] >> shift) & 0xff;
+
+							texel |= (sum / 4) << shift;
+						}
+
+						next.at(x, y) = texel;
+					}
+				}
+
+				levels.push_back(next);
+			}
+		}
+
+	public:
+		// Find or load a texture by asset path. Textures are shared between
+		// every face that uses them, and live as long as the asset data.
+		// Meshes may be loaded off the main thread, so lookups are locked.
+		static Texture *get(const string &fname){
+			SDL_LockMutex(textures_lock);
+
+			auto it = textures.find(fname);
+
+			if(it != textures.end()){
+				SDL_UnlockMutex(textures_lock);
+				return it->second;
+			}
+
+			Texture *tex = NULL;
+			FileLoader *fl = FileLoader::get(fname);
+			SDL_Surface *sf = (fl ? fl->surface() : NULL);
+
+			if(sf)
+				tex = new Texture(sf);
+			else
+				cout << "Failed to load texture: " << fname << endl;
+
+			textures[fname] = tex;
+			SDL_UnlockMutex(textures_lock);
+
+			return tex;
+		}
+
+		// Choose the mip level whose texels are closest to one per pixel,
+		// given the change in u and v for a single pixel step.
+		int level_for(const double &du, const double &dv) const {
+			double footprint = max(abs(du) * levels[0].w, abs(dv) * levels[0].h);
+			int level = 0, last = levels.size() - 1;
+
+			while((footprint >= 2.0) && (level < last)){
+				footprint /= 2;
+				level++;
+			}
+
+			return level;
+		}
+
+		// Nearest-texel lookup with wrapping. The result is ARGB, which is
+		// BGRA in memory like the camera's frame buffer.
+		inline uint32_t sample(const int &level, const double &u, const double &v) const {
+			const Level &l = levels[level];
+			int x = ((int)(u * l.w + (1 << 20))) & (l.w - 1);
+			int y = ((int)(v * l.h + (1 << 20))) & (l.h - 1);
+
+			return l.at(x, y);
+		}
+	};
+
 	struct Renderable : public Drawable {
 		Camera *cam;
 
@@ -342,11 +818,14 @@ public:
 		struct Face {
 			vector<int> vertIds;
 			Mesh *mesh;
-			byte_t *fill;
+			byte_t fill[4];
+
+			// Optional texture, with a u,v pair for each entry in vertIds.
+			Texture *tex = NULL;
+			vector<double> uvs;
 
 			Face(vector<int> vertIds, const byte_t fill[4]){
 				this->vertIds = vertIds;
-				this->fill = (byte_t*) calloc(4, sizeof(byte_t));
 				memcpy(this->fill, fill, 4);
 			}
 
@@ -355,17 +834,92 @@ public:
 
 				memcpy(fill, color, 4);
 			}
+
+			// Faces with any transparency are drawn in the blended pass.
+			inline bool transparent() const {
+				return (fill[3] != 0xff);
+			}
+
+			coord centroid() const {
+				coord c = { 0, 0, 0 };
+
+				for(int id : vertIds)
+					c += mesh->vertex(id);
+
+				return c / vertIds.size();
+			}
+		};
+
+		// An edge between two vertices, shared by one or more faces. The lower
+		// vertex id is always first, so an edge is rasterized identically no
+		// matter which face it is traced for.
+		struct Edge {
+			int a, b;
+
+			// True if any face using this edge is opaque, which means the edge
+			// is drawn as a solid border.
+			bool opaque;
 		};
 
 		vector<coord> vertices;
-		list<Face*> faces;
+		vector<Face> faces;
+		vector<Edge> edges;
+
+		// Once quantize() is called, positions are kept here instead of in
+		// vertices, as 16-bit steps across the bounding box, and expanded
+		// again while the mesh is drawn.
+		vector<int16_t> packed;
+		double packed_origin[3] = { 0, 0, 0 }, packed_step[3] = { 0, 0, 0 };
+		static vector<coord> unpacked;
+
+		// Dynamic meshes are left out of static batches, since they are
+		// expected to move or change after the scene is built.
+		bool dynamic = false;
+
+		// Draw a black border along the edges of opaque faces.
+		bool outline = true;
+
+		// Index of each vertex as numbered in the mesh file, or -1 if it was
+		// welded away, for matching up animation clips.
+		vector<int> source_map;
+
+		// The clip being played, if any, and the pose it's played over.
+		Clip *clip = NULL;
+		double clip_time = 0;
+		vector<coord> rest;
+
+		// Bounding sphere, and a counter bumped whenever the geometry or
+		// colors change so that cached renderings can tell they're stale.
+		coord bound_center;
+		double bound_radius;
+		unsigned int revision = 0;
+
+		// Id of this mesh in the visibility buffer for the current frame,
+		// with the face bits clear.
+		uint64_t vis_id = 0;
+
+		vector<pixel> vertScreen;
+		vector<double> vertDepth, vertYaw;
+
+		// Texture coordinates divided by depth, and the inverse depth, at the
+		// left and right ends of each scanline. These interpolate linearly
+		// across the screen, unlike u and v themselves.
+		struct uvw {
+			double u, v, w;
+		};
 
-		unordered_map<int, pixel> vertIdToScreen;
-		pixel *scanlines;
-		coord *scanlines_coords;
-		int y_min, y_max;
+		// Rasterizer scratch space. Only one face is ever being traced and
+		// filled at a time, so this is shared by every mesh.
+		static pixel scanlines[SCREEN_HEIGHT];
+		static coord scanlines_coords[SCREEN_HEIGHT * 2];
+		static uvw scanlines_uvw[SCREEN_HEIGHT * 2];
+		static int y_min, y_max;
 
-		void resetScanlines(){
+		// Mesh files parsed ahead of time by preparse, until load takes them.
+		static map<string, MeshData*> parsed;
+		static SDL_mutex *parsed_lock;
+
+		static void resetScanlines(){
 			for(int line = y_min; line <= y_max; line++)
 				scanlines[line] = (pixel){ SCREEN_WIDTH, 0 };
 
@@ -373,334 +927,2359 @@ public:
 			y_max = 0;
 		}
 
-		Mesh(Camera *cam, vector<coord> vertices, list<Face*> faces) :
-			Renderable(cam)
+		Mesh(Camera *cam, const vector<coord> &vertices, const vector<Face> &faces) :
+			Renderable(cam),
+			vertices(vertices),
+			faces(faces)
 		{
-			this->vertices = vertices;
+			for(Face &face : this->faces)
+				face.mesh = this;
+
+			build_edges();
+			update_bounds();
+		}
+
+		// Pack several meshes into one: their vertices and faces are copied
+		// into single contiguous arrays, and the result is drawn with one call.
+		static Mesh *merge(Camera *cam, const list<Mesh*> &meshes){
+			vector<coord> vertices;
+			vector<Face> faces;
+			size_t vertex_count = 0, face_count = 0;
 
-			for(Face *face : faces){
-				face->mesh = this;
-				this->faces.push_back(face);
+			for(Mesh *mesh : meshes){
+				vertex_count += mesh->vertex_count();
+				face_count += mesh->faces.size();
 			}
 
-			scanlines = (pixel*) calloc(SCREEN_HEIGHT, sizeof(pixel));
-			scanlines_coords = (coord*) calloc(SCREEN_HEIGHT * 2, sizeof(coord));
-			y_min = 0;
-			y_max = SCREEN_HEIGHT - 1;
-			resetScanlines();
-		}
-		~Mesh(){
-			free(scanlines);
-			free(scanlines_coords);
+			vertices.reserve(vertex_count);
+			faces.reserve(face_count);
+
+			for(Mesh *mesh : meshes){
+				int offset = vertices.size();
 
-			for(Face *f : faces)
-				delete f;
+				for(int i = 0, len = mesh->vertex_count(); i < len; i++)
+					vertices.push_back(mesh->vertex(i));
+				for(const Face &face : mesh->faces){
+					faces.push_back(face);
+
+					for(int &id : faces.back().vertIds)
+						id += offset;
+				}
+			}
+
+			return new Mesh(cam, vertices, faces);
 		}
 
-		// Load mesh data from an asset file.
-		static Mesh* load(Camera *cam, string fname){
+		// Read, weld, triangulate and reorder a mesh file, and load its
+		// textures. Returns NULL if the file is missing or malformed.
+		static MeshData *parse(const string &fname){
 			FileLoader *fl = FileLoader::get(fname);
 
 			if(!fl)
 				return NULL;
 
-			stringstream data(fl->text());
-			vector<coord> vertices;
-			list<Face*> faces;
-			int vert_offset = 0;
+			MeshData *md = new MeshData();
+			if(!md->parse(fl->text())){
+				cout << "Model parsing error in [" << fname << "]" << endl;
+				delete md;
+				return NULL;
+			}
+			md->optimize();
 
-			// Match a string identifier opening a curly brace block
-			regex rx_mesh_start("\\s*(\\S*)\\s*\\{\\s*");
-			regex rx_mesh_end("\\s*\\}\\s*");
-			regex rx_braced("\\s*\\{([^\\}]*)\\}(.*)");
-			regex rx_spaced_numbers("[0-9.-]+");
-			regex rx_rgba(".*([0-9a-fA-F]{2})([0-9a-fA-F]{2})([0-9a-fA-F]{2})([0-9a-fA-F]{2}).*");
+			for(const MeshData::polygon &poly : md->polygons)
+				if(!poly.texture.empty())
+					Texture::get(poly.texture);
 
-			// Parse all mesh data from resource.
-			string line;
-			while(getline(data, line)){
-				if(line.length() == 0)
-					continue;
+			return md;
+		}
 
-				// Out of data to parse.
-				if(line == "EOF")
-					break;
+		// Parse a mesh file now, on any thread, so that the next load of it
+		// only has to build the mesh.
+		static void preparse(const string &fname){
+			MeshData *md = parse(fname);
 
-				smatch sm;
-				if(regex_match(line, sm, rx_mesh_start)){
-					string mesh_name = sm[1];
-					int verts = 0;
+			if(!md)
+				return;
 
-					while(getline(data, line)){
-						if(line.length() == 0)
-							continue;
+			SDL_LockMutex(parsed_lock);
 
-						// Move up a level.
-						if(regex_match(line, rx_mesh_end))
-							break;
-
-						// Found a new block element.
-						if(regex_match(line, sm, rx_mesh_start)){
-							string mesh_element = sm[1];
-
-							bool faces_element = false;
-							bool coords_element = false;
-
-							if(mesh_element == "coords")
-								coords_element = true;
-							else if(mesh_element == "faces")
-								faces_element = true;
-
-							while(getline(data, line)){
-								if(line.length() == 0)
-									continue;
-
-								// Move up a level.
-								if(regex_match(line, rx_mesh_end))
-									break;
-
-								if(coords_element || faces_element){
-									if(regex_match(line, sm, rx_braced)){
-										string braced_data = sm[1];
-										string braced_data_extra = sm[2];
-
-										if(coords_element){
-											coord c;
-
-											for(int i = 0; (i < 3) && regex_search(braced_data, sm, rx_spaced_numbers); i++){
-												double pt = atof(sm[0].str().c_str());
-
-												switch(i){
-													case 0:
-														c.x = pt;
-														break;
-													case 1:
-														c.y = pt;
-														break;
-													case 2:
-														c.z = pt;
-														break;
-												}
-
-												braced_data = sm.suffix().str();
-											}
-
-											vertices.push_back(c);
-											verts++;
-										}
-
-										if(faces_element){
-											vector<int> vertIds;
-											byte_t color[4];
-
-											// Get the fill color for this face.
-											if(regex_match(braced_data_extra, sm, rx_rgba)){
-												for(int i = 0; i < 4; i++){
-													unsigned char color_value;
-													stringstream color_string;
-
-													color_string << hex << sm[i + 1];
-													color_string >> color_value;
-
-													color[i] = color_value;
-												}
-											}
-
-											while(regex_search(braced_data, sm, rx_spaced_numbers)){
-												vertIds.push_back(vert_offset + atoi(sm[0].str().c_str()));
-												braced_data = sm.suffix().str();
-											}
-
-											if(vertIds.size()){
-												Face *face = new Face(vertIds, color);
-												faces.push_back(face);
-											}
-										}
-									}
-								}
-							}
+			auto it = parsed.find(fname);
 
-						}
+			if(it != parsed.end())
+				delete it->second;
 
-						if(line == "EOF"){
-							cout << "Model parsing error in [" << fname << "]" << endl;
-							return NULL;
-						}
-					}
+			parsed[fname] = md;
+			SDL_UnlockMutex(parsed_lock);
+		}
 
-					vert_offset += verts;
-				}
+		// Load mesh data from an asset file, or take it from preparse.
+		static Mesh* load(Camera *cam, asset::id id){
+			return load(cam, FileLoader::name(id));
+		}
+		static Mesh* load(Camera *cam, string fname){
+			MeshData *pmd = NULL;
+
+			SDL_LockMutex(parsed_lock);
+
+			auto it = parsed.find(fname);
+
+			if(it != parsed.end()){
+				pmd = it->second;
+				parsed.erase(it);
 			}
 
-			// Keep track of face count and increment indices for subsequent meshes
+			SDL_UnlockMutex(parsed_lock);
 
-			return new Mesh(cam, vertices, faces);
+			if(!pmd && !(pmd = parse(fname)))
+				return NULL;
+
+			const MeshData &md = *pmd;
+			vector<coord> vertices;
+			vector<Face> faces;
+
+			vertices.reserve(md.vertices.size());
+			for(const MeshData::vertex &v : md.vertices)
+				vertices.push_back((coord){ v.x, v.y, v.z });
+
+			faces.reserve(md.polygons.size());
+			for(const MeshData::polygon &poly : md.polygons){
+				const byte_t color[4] = { poly.color[2], poly.color[1], poly.color[0], poly.color[3] }; // BGRA
+				Face face(poly.verts, color);
+
+				if(!poly.texture.empty() && (face.tex = Texture::get(poly.texture)))
+					face.uvs = poly.uvs;
+
+				faces.push_back(face);
+			}
+
+			Mesh *mesh = new Mesh(cam, vertices, faces);
+			mesh->source_map = md.source_map;
+
+			delete pmd;
+
+			return mesh;
+		}
+
+		// Start playing a clip from its first frame, or stop with NULL. The
+		// mesh is marked dynamic, and returns to its rest pose when stopped.
+		void play(Clip *clip){
+			if(clip)
+				unquantize();
+
+			if(!this->clip && clip)
+				rest = vertices;
+			else if(this->clip && !clip)
+				vertices = rest;
+
+			this->clip = clip;
+			clip_time = 0;
+
+			if(clip)
+				dynamic = true;
+
+			update_bounds();
+		}
+
+		// Advance the playing clip and pose the mesh for the new time.
+		void animate(const double &seconds){
+			if(!clip || (clip->frames < 1) || (clip->verts != (int) vertices.size()))
+				return;
+
+			clip_time += seconds;
+
+			double f = fmod(clip_time * clip->fps, (double) clip->frames);
+			int k0 = (int) f, k1 = ((k0 + 1) % clip->frames);
+
+			lerp_deltas(
+				clip->frame(k0), clip->frame(k1),
+				&rest[0].x, &vertices[0].x,
+				3 * vertices.size(), (float)(f - k0), clip->scale
+			);
+
+			update_bounds();
+			revision++;
+		}
+
+		// Rough count of the bytes held by this mesh.
+		size_t memory() const {
+			size_t bytes = sizeof(Mesh);
+
+			bytes += vertices.capacity() * sizeof(coord) + packed.capacity() * sizeof(int16_t);
+			bytes += vertScreen.capacity() * sizeof(pixel) + (vertDepth.capacity() + vertYaw.capacity()) * sizeof(double);
+			bytes += edges.capacity() * sizeof(Edge);
+
+			for(const Face &face : faces)
+				bytes += sizeof(Face) + face.vertIds.capacity() * sizeof(int) + face.uvs.capacity() * sizeof(double);
+
+			return bytes;
 		}
 
 		void translate(const coord &delta){
+			packed_origin[0] += delta.x;
+			packed_origin[1] += delta.y;
+			packed_origin[2] += delta.z;
+
 			for(coord &c : vertices)
 				c = c + delta;
+			for(coord &c : rest)
+				c = c + delta;
+
+			update_bounds();
 		}
 
 		// Set the fill color for all faces of this Mesh.
 		void set_color_fill(const byte_t &r, const byte_t &g, const byte_t &b, const byte_t &a){
-			for(Face *face : faces)
-				face->set_color_fill(r, g, b, a);
-		}
+			for(Face &face : faces)
+				face.set_color_fill(r, g, b, a);
 
-		void populateScreenspace(){
-			for(int i = 0, len = vertices.size(); i < len; i++)
-				vertIdToScreen[i] = cam->vertex_screenspace(vertices[i]);
+			revision++;
 		}
 
-		// Draw a line on the screen to connect two pixels.
-		void drawLine(const int &vert_a, const int &vert_b){
-			coord a = vertices[vert_a];
-			coord b = vertices[vert_b];
+		// Recompute the bounding sphere around the center of the bounding box.
+		void update_bounds(){
+			coord lo = { 0, 0, 0 }, hi = { 0, 0, 0 };
 
-			{
-				double yaw_a = ((a - cam->pos).angle_xz() - cam->point_xz);
-				double yaw_b = ((b - cam->pos).angle_xz() - cam->point_xz);
+			for(int i = 0, len = vertex_count(); i < len; i++){
+				const coord v = vertex(i);
 
-				if(
-					(abs(yaw_a) > (PI / 2) && abs(yaw_b) > cam->maxangle_w) ||
-					(abs(yaw_b) > (PI / 2) && abs(yaw_a) > cam->maxangle_w)
-				)
-					return;
+				if(!i){
+					lo = hi = v;
+					continue;
+				}
+
+				lo = (coord){ min(lo.x, v.x), min(lo.y, v.y), min(lo.z, v.z) };
+				hi = (coord){ max(hi.x, v.x), max(hi.y, v.y), max(hi.z, v.z) };
 			}
 
-			pixel from = vertIdToScreen[vert_a];
-			pixel to = vertIdToScreen[vert_b];
+			bound_center = (lo + hi) * 0.5;
+			bound_radius = 0;
+			for(int i = 0, len = vertex_count(); i < len; i++)
+				bound_radius = max(bound_radius, bound_center.distance_to(vertex(i)));
 
-			double x = from.x;
-			double y = from.y;
-			double dx = to.x - from.x;
-			double dy = to.y - from.y;
-			double step = 2.0 * ((abs(dx) >= abs(dy)) ? abs(dx) : abs(dy));
-			coord coord_step = (b - a) / step;
+			revision++;
+		}
 
-			dx /= step;
-			dy /= step;
+		// Collect the unique edges of all faces, so that borders shared by two
+		// faces are only drawn once. An edge between exactly two coplanar
+		// faces of the same color and texture is left out, since it only
+		// splits a flat polygon (such as a triangulated quad).
+		void build_edges(){
+			struct edge_use {
+				Face *first;
+				int count;
+			};
 
-			const byte_t fill[4] = { 0x00, 0x00, 0x00, 0xff };
-			for(int i = 1; i <= step; i++){
-				pixel px = cam->vertex_screenspace(a + (coord_step * i));
-				//pixel px = (pixel){ (int) x, (int) y };
+			unordered_map<uint64_t, int> index;
+			vector<edge_use> uses;
 
-				if(px.y > y_max)
-					y_max = px.y;
-				if(px.y < y_min)
-					y_min = px.y;
+			edges.clear();
+			for(Face &face : faces){
+				for(int i = 0, len = face.vertIds.size(); i < len; i++){
+					int a = face.vertIds[i];
+					int b = face.vertIds[((i == len - 1) ? 0 : (i + 1))];
 
-				if((px.y >= 0) && (px.y < SCREEN_HEIGHT)){
-					pixel bounds = scanlines[px.y];
+					if(a > b)
+						swap(a, b);
 
-					if(px.x < bounds.x){
-						bounds.x = px.x;
-						scanlines_coords[2 * px.y] = a + (coord_step * i);
-					}
+					uint64_t key = (((uint64_t) a) << 32) | (uint32_t) b;
+					auto it = index.find(key);
 
-					if(px.x > bounds.y){
-						bounds.y = px.x;
-						scanlines_coords[2 * px.y + 1] = a + (coord_step * i);
-					}
+					if(it == index.end()){
+						index[key] = edges.size();
+						edges.push_back((Edge){ a, b, !face.transparent() });
+						uses.push_back((edge_use){ &face, 1 });
+					} else {
+						edge_use &use = uses[it->second];
 
-					scanlines[px.y] = bounds;
+						if(!face.transparent())
+							edges[it->second].opaque = true;
+
+						if(use.count++ == 1)
+							use.first = (face_flush(*use.first, face) ? NULL : use.first);
+					}
 				}
+			}
 
-				if((px.x >= 0) && (px.y >= 0) && (px.x < SCREEN_WIDTH) && (px.y < SCREEN_HEIGHT)){
-					int offset = (SCREEN_WIDTH * px.y + px.x);
-					double distance = cam->pos.distance_to(a + (coord_step * i));
+			for(int i = edges.size() - 1; i >= 0; i--){
+				if((uses[i].count == 2) && !uses[i].first){
+					edges[i] = edges.back();
+					edges.pop_back();
+				}
+			}
+		}
 
-					//coord px_coord = (a + (coord_step * i));
-					//double distance = cam->pos.distance_to(px_coord) * cos((px_coord - cam->pos).angle_xz() - cam->point_xz);
+		// Plane normal of a face, by Newell's method.
+		coord face_normal(const Face &face) const {
+			coord n = { 0, 0, 0 };
 
-					// Draw this pixel if there isn't already one in front of it.
-					if(distance < cam->screenspace_zb[offset]){
-						memcpy(&cam->screenspace_px[offset * 4], fill, 4);
-						cam->screenspace_zb[offset] = distance;
-					}
-				}
+			for(int i = 0, len = face.vertIds.size(); i < len; i++){
+				const coord a = vertex(face.vertIds[i]);
+				const coord b = vertex(face.vertIds[(i + 1) % len]);
 
-				x += dx;
-				y += dy;
+				n += (coord){
+					(a.y - b.y) * (a.z + b.z),
+					(a.z - b.z) * (a.x + b.x),
+					(a.x - b.x) * (a.y + b.y)
+				};
 			}
+
+			double len = n.distance_to((coord){ 0, 0, 0 });
+			return (len ? (n * (1.0 / len)) : n);
 		}
 
-		void draw_face(const Face &face){
-			resetScanlines();
+		// True if two faces lie in the same plane and look the same.
+		bool face_flush(const Face &a, const Face &b) const {
+			coord na = face_normal(a), nb = face_normal(b);
+
+			return (
+				!memcmp(a.fill, b.fill, 4) && (a.tex == b.tex) &&
+				((na.x * nb.x + na.y * nb.y + na.z * nb.z) > 0.9999)
+			);
+		}
 
-			// Draw the border, and build a set of pixel coordinates that
-			// represent the outline.
-			SDL_SetRenderDrawColor(rend, 0, 0, 0, 0xff);
-			for(int i = 0, len = face.vertIds.size(); i < len; i++)
-				drawLine(face.vertIds[i], face.vertIds[((i == len - 1) ? 0 : (i + 1))]);
+		int vertex_count() const {
+			return (packed.empty() ? vertices.size() : (packed.size() / 3));
+		}
 
-			if(y_min < 0)
-				y_min = 0;
-			if(y_max > (SCREEN_HEIGHT - 1))
-				y_max = (SCREEN_HEIGHT - 1);
+		// Position of a vertex, expanding it if the mesh is quantized.
+		inline coord vertex(const int &i) const {
+			if(packed.empty())
+				return vertices[i];
 
-			// Fill each line.
-			if(y_min < y_max){
-				const byte_t fill_black_data[4] = { 0x00, 0x00, 0x00, face.fill[3] };
+			const int16_t *q = &packed[3 * i];
 
-				for(int line = y_min; line <= y_max; line++){
-					pixel bounds = scanlines[line];
-					coord coord_left = scanlines_coords[2 * line];
-					coord coord_delta = (scanlines_coords[2 * line + 1] - coord_left) / (bounds.y - bounds.x);
-					bool fill_black = false;
+			return (coord){
+				packed_origin[0] + q[0] * packed_step[0],
+				packed_origin[1] + q[1] * packed_step[1],
+				packed_origin[2] + q[2] * packed_step[2]
+			};
+		}
 
-					if((line == y_min) || (line == y_max))
-						fill_black = true;
+		// Store positions as 16-bit steps across the bounding box, which is a
+		// quarter of the memory. Meshes playing a clip are left alone.
+		void quantize(){
+			const int len = vertices.size();
 
-					for(int x = bounds.x + 1; x < bounds.y; x++){
-						if(((x == (bounds.x + 1)) || (x == (bounds.y - 1))) && !((line == y_min) || (line == y_max)))
-							fill_black = true;
+			if(!packed.empty() || clip || !len)
+				return;
 
-						if((x >= 0) && (line >= 0) && (x < SCREEN_WIDTH) && (line < SCREEN_HEIGHT)){
-							const unsigned int offset = (SCREEN_WIDTH * line + x);
-							double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+			coord lo = vertices[0], hi = vertices[0];
+			for(const coord &v : vertices){
+				lo = (coord){ min(lo.x, v.x), min(lo.y, v.y), min(lo.z, v.z) };
+				hi = (coord){ max(hi.x, v.x), max(hi.y, v.y), max(hi.z, v.z) };
+			}
 
-							//coord px_coord = (coord_left + (coord_delta * (x - bounds.x)));
-							//double distance = cam->pos.distance_to(px_coord) * cos((px_coord - cam->pos).angle_xz() - cam->point_xz);
+			const double lo_axis[3] = { lo.x, lo.y, lo.z }, hi_axis[3] = { hi.x, hi.y, hi.z };
+			for(int a = 0; a < 3; a++){
+				packed_step[a] = max((hi_axis[a] - lo_axis[a]) / 65535, 1e-9);
+				packed_origin[a] = lo_axis[a] + 32768 * packed_step[a];
+			}
 
-							// Draw this pixel if there isn't already one in front of it.
-							if(!cam->wireframe && (distance < cam->screenspace_zb[offset])){
-								memcpy(&cam->screenspace_px[offset * 4], (fill_black ? fill_black_data : face.fill), 4);
-								cam->screenspace_zb[offset] = distance;
-							}
-						}
+			packed.resize(3 * len);
+			for(int i = 0; i < len; i++){
+				const double v[3] = { vertices[i].x, vertices[i].y, vertices[i].z };
 
-						if((x == (bounds.x + 1)) && !((line == y_min) || (line == y_max)))
-							fill_black = false;
-					}
+				for(int a = 0; a < 3; a++){
+					long q = lround((v[a] - packed_origin[a]) / packed_step[a]);
+
+					packed[3 * i + a] = (int16_t)((q < -32768) ? -32768 : ((q > 32767) ? 32767 : q));
 				}
 			}
+
+			vector<coord>().swap(vertices);
+			update_bounds();
 		}
 
-		virtual void draw(int ticks){
-			populateScreenspace();
+		// Go back to full precision positions.
+		void unquantize(){
+			if(packed.empty())
+				return;
+
+			const int len = vertex_count();
 
-			// Sort faces by distance to the camera. Far faces are drawn first.
-			for(Face *face : faces)
-				draw_face(*face);
+			vertices.resize(len);
+			for(int i = 0; i < len; i++)
+				vertices[i] = vertex(i);
+
+			vector<int16_t>().swap(packed);
 		}
-	};
 
-	// Objects
-	list<Mesh*> drawable_meshes;
+		void populateScreenspace(){
+			int len = vertex_count();
 
-	virtual ~Scene3D(){}
+			vertScreen.resize(len);
+			vertDepth.resize(len);
+			vertYaw.resize(len);
 
-	virtual void draw(int ticks){
+			// Quantized positions are expanded into scratch space shared by
+			// every mesh, since only one is transformed at a time.
+			const coord *positions = NULL;
+
+			if(!packed.empty()){
+				if((int) unpacked.size() < len)
+					unpacked.resize(len);
+
+				dequantize(&packed[0], &unpacked[0].x, 3 * len, packed_origin, packed_step);
+				positions = &unpacked[0];
+			} else if(len){
+				positions = &vertices[0];
+			}
+
+			for(int i = 0; i < len; i++){
+				const coord &v = positions[i];
+
+				vertScreen[i] = cam->vertex_screenspace(v);
+				vertDepth[i] = cam->pos.distance_to(v);
+				vertYaw[i] = ((v - cam->pos).angle_xz() - cam->point_xz);
+			}
+		}
+
+		// Widen a row's scanline bounds to take in x, with the world coordinate
+		// and texture coordinates there.
+		static void bound_scanline(const int &y, const int &x, const coord &c, const uvw &t){
+			pixel &bounds = scanlines[y];
+
+			if(x < bounds.x){
+				bounds.x = x;
+				scanlines_coords[2 * y] = c;
+				scanlines_uvw[2 * y] = t;
+			}
+
+			if(x > bounds.y){
+				bounds.y = x;
+				scanlines_coords[2 * y + 1] = c;
+				scanlines_uvw[2 * y + 1] = t;
+			}
+		}
+
+		// Draw a line on the screen to connect two vertices, stepping one pixel
+		// at a time along the major axis with integer error terms. The world
+		// coordinate and depth are interpolated along the line. If plot is
+		// false the line only contributes to the scanline bounds. Texture
+		// coordinates for each end may be given for textured faces.
+		void drawLine(int vert_a, int vert_b, const bool &plot = true, const double *uv_a = NULL, const double *uv_b = NULL){
+			if(vert_a > vert_b){
+				swap(vert_a, vert_b);
+				swap(uv_a, uv_b);
+			}
+
+			{
+				double yaw_a = abs(vertYaw[vert_a]);
+				double yaw_b = abs(vertYaw[vert_b]);
+
+				if(
+					(yaw_a > (PI / 2) && yaw_b > cam->maxangle_w) ||
+					(yaw_b > (PI / 2) && yaw_a > cam->maxangle_w)
+				)
+					return;
+			}
+
+			const pixel from = vertScreen[vert_a];
+			const pixel to = vertScreen[vert_b];
+			const bool off_side = (((from.x < 0) && (to.x < 0)) || ((from.x >= cam->w) && (to.x >= cam->w)));
+
+			// Skip lines which are entirely above or below the screen, or which
+			// are off to one side and only being drawn.
+			if(
+				((from.y < 0) && (to.y < 0)) || ((from.y >= cam->h) && (to.y >= cam->h)) ||
+				(plot && off_side)
+			){
+				if(from.y < y_min)
+					y_min = from.y;
+				if(to.y < y_min)
+					y_min = to.y;
+				if(from.y > y_max)
+					y_max = from.y;
+				if(to.y > y_max)
+					y_max = to.y;
+
+				return;
+			}
+
+			const int dx = abs(to.x - from.x), sx = ((from.x < to.x) ? 1 : -1);
+			const int dy = -abs(to.y - from.y), sy = ((from.y < to.y) ? 1 : -1);
+			const int steps = ((dx > -dy) ? dx : -dy);
+
+			coord c = vertex(vert_a);
+			coord c_step = (steps ? ((vertex(vert_b) - c) / steps) : (coord){ 0, 0, 0 });
+			double depth = vertDepth[vert_a];
+			double depth_step = (steps ? ((vertDepth[vert_b] - depth) / steps) : 0);
+
+			uvw t = { 0, 0, 0 }, t_step = { 0, 0, 0 };
+			if(uv_a){
+				double w_a = 1.0 / max(vertDepth[vert_a], 1e-6);
+				double w_b = 1.0 / max(vertDepth[vert_b], 1e-6);
+
+				t = (uvw){ uv_a[0] * w_a, uv_a[1] * w_a, w_a };
+				if(steps)
+					t_step = (uvw){
+						(uv_b[0] * w_b - t.u) / steps,
+						(uv_b[1] * w_b - t.v) / steps,
+						(w_b - t.w) / steps
+					};
+			}
+
+			// A traced line off to one side of the screen still bounds the rows
+			// it crosses, but nothing on it is visible, so step a row at a time
+			// over just the rows on screen rather than along every pixel.
+			if(off_side){
+				const int rows = to.y - from.y;
+				const uvw t_b = { t.u + t_step.u * steps, t.v + t_step.v * steps, t.w + t_step.w * steps };
+				const coord c_b = vertex(vert_b);
+
+				if(min(from.y, to.y) < y_min)
+					y_min = min(from.y, to.y);
+				if(max(from.y, to.y) > y_max)
+					y_max = max(from.y, to.y);
+
+				for(int y = max(min(from.y, to.y), 0), y_end = min(max(from.y, to.y), cam->h - 1); y <= y_end; y++){
+					const double f = (rows ? ((double)(y - from.y) / rows) : 0);
+
+					bound_scanline(
+						y, from.x + (int) lround((to.x - from.x) * f),
+						c + ((c_b - c) * f),
+						(uvw){ t.u + (t_b.u - t.u) * f, t.v + (t_b.v - t.v) * f, t.w + (t_b.w - t.w) * f }
+					);
+				}
+
+				return;
+			}
+
+			const byte_t fill[4] = { 0x00, 0x00, 0x00, 0xff };
+			const byte_t fill_ix = (cam->indexed ? Camera::quantize(fill) : 0);
+			int x = from.x, y = from.y, err = dx + dy;
+
+			for(int i = 0; i <= steps; i++){
+				if(y > y_max)
+					y_max = y;
+				if(y < y_min)
+					y_min = y;
+
+				if((y >= 0) && (y < cam->h)){
+					bound_scanline(y, x, c, t);
+
+					// Draw this pixel if there isn't already one in front of it.
+					if(plot && (x >= 0) && (x < cam->w)){
+						int offset = (cam->w * y + x);
+
+						if(depth < cam->screenspace_zb[offset]){
+							if(cam->deferred)
+								cam->screenspace_id[offset] = (vis_id | VIS_FACE_EDGE);
+							else if(cam->indexed)
+								cam->screenspace_ix[offset] = fill_ix;
+							else
+								memcpy(&cam->screenspace_px[offset * 4], fill, 4);
+
+							cam->screenspace_zb[offset] = depth;
+						}
+					}
+				}
+
+				// Advance to the next pixel along the line.
+				int e2 = 2 * err;
+				if(e2 >= dy){
+					err += dy;
+					x += sx;
+				}
+				if(e2 <= dx){
+					err += dx;
+					y += sy;
+				}
+
+				c += c_step;
+				depth += depth_step;
+				t.u += t_step.u;
+				t.v += t_step.v;
+				t.w += t_step.w;
+			}
+		}
+
+		// Draw the border of every edge used by an opaque face. With wireframe
+		// set, every edge is drawn.
+		void draw_edges(){
+			resetScanlines();
+
+			for(const Edge &edge : edges)
+				if(edge.opaque || cam->wireframe)
+					drawLine(edge.a, edge.b);
+
+			if(y_min < 0)
+				y_min = 0;
+			if(y_max > (cam->h - 1))
+				y_max = (cam->h - 1);
+		}
+
+		// Trace the outline of a face into the scanline bounds, without drawing
+		// it. The border itself is drawn once per edge by draw_edges.
+		void trace_face(const Face &face){
+			resetScanlines();
+
+			for(int i = 0, len = face.vertIds.size(); i < len; i++){
+				int next = ((i == len - 1) ? 0 : (i + 1));
+
+				if(face.tex)
+					drawLine(face.vertIds[i], face.vertIds[next], false, &face.uvs[2 * i], &face.uvs[2 * next]);
+				else
+					drawLine(face.vertIds[i], face.vertIds[next], false);
+			}
+
+			if(y_min < 0)
+				y_min = 0;
+			if(y_max > (cam->h - 1))
+				y_max = (cam->h - 1);
+		}
+
+		void draw_face(const Face &face){
+			const uint64_t id = (vis_id | (uint64_t)(&face - &faces[0]));
+			const byte_t fill_ix = (cam->indexed ? Camera::quantize(face.fill) : 0);
+
+			trace_face(face);
+
+			// Fill each line.
+			if(y_min < y_max){
+				for(int line = y_min; line <= y_max; line++){
+					pixel bounds = scanlines[line];
+					coord coord_left = scanlines_coords[2 * line];
+					coord coord_delta = (scanlines_coords[2 * line + 1] - coord_left) / (bounds.y - bounds.x);
+
+					int x_start = ((bounds.x + 1 < 0) ? 0 : (bounds.x + 1));
+					int x_end = ((bounds.y > cam->w) ? cam->w : bounds.y);
+
+					// Deferred cameras only need to know which face won.
+					if(cam->deferred){
+						for(int x = x_start; x < x_end; x++){
+							const unsigned int offset = (cam->w * line + x);
+							double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+							if(distance < cam->screenspace_zb[offset]){
+								cam->screenspace_id[offset] = id;
+								cam->screenspace_zb[offset] = distance;
+							}
+						}
+
+						continue;
+					}
+
+					if(face.tex){
+						draw_span_textured(face, line, x_start, x_end);
+						continue;
+					}
+
+					if(cam->indexed){
+						for(int x = x_start; x < x_end; x++){
+							const unsigned int offset = (cam->w * line + x);
+							double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+							if(distance < cam->screenspace_zb[offset]){
+								cam->screenspace_ix[offset] = fill_ix;
+								cam->screenspace_zb[offset] = distance;
+							}
+						}
+
+						continue;
+					}
+
+					for(int x = x_start; x < x_end; x++){
+						const unsigned int offset = (cam->w * line + x);
+						double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+						// Draw this pixel if there isn't already one in front of it.
+						if(distance < cam->screenspace_zb[offset]){
+							memcpy(&cam->screenspace_px[offset * 4], face.fill, 4);
+							cam->screenspace_zb[offset] = distance;
+						}
+					}
+				}
+			}
+		}
+
+		// Perspective-correct texture coordinates at column x of a traced
+		// scanline.
+		inline void uv_at(const int &line, const double &x, double &u, double &v) const {
+			const pixel &bounds = scanlines[line];
+			const uvw &l = scanlines_uvw[2 * line], &r = scanlines_uvw[2 * line + 1];
+			double t = ((bounds.y > bounds.x) ? ((x - bounds.x) / (bounds.y - bounds.x)) : 0);
+			double w = l.w + (r.w - l.w) * t;
+
+			u = (l.u + (r.u - l.u) * t) / w;
+			v = (l.v + (r.v - l.v) * t) / w;
+		}
+
+		// Fill part of a scanline from a texture. The exact texture
+		// coordinates are only computed every TEXTURE_SPAN pixels, and
+		// interpolated linearly in between. The mip level is chosen once for
+		// each of those sub-spans.
+		void draw_span_textured(const Face &face, const int &line, const int &x_start, const int &x_end){
+			const pixel bounds = scanlines[line];
+			const coord coord_left = scanlines_coords[2 * line];
+			const coord coord_delta = (scanlines_coords[2 * line + 1] - coord_left) / (bounds.y - bounds.x);
+
+			double u_next, v_next;
+			uv_at(line, x_start, u_next, v_next);
+
+			for(int x = x_start; x < x_end;){
+				int x_next = min(x + TEXTURE_SPAN, x_end);
+				double u = u_next, v = v_next;
+
+				uv_at(line, x_next, u_next, v_next);
+
+				const double du = (u_next - u) / (x_next - x);
+				const double dv = (v_next - v) / (x_next - x);
+				const int level = face.tex->level_for(du, dv);
+
+				for(; x < x_next; x++, u += du, v += dv){
+					const unsigned int offset = (cam->w * line + x);
+					double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+					if(distance < cam->screenspace_zb[offset]){
+						uint32_t texel = face.tex->sample(level, u, v);
+
+						if(cam->indexed)
+							cam->screenspace_ix[offset] = Camera::quantize(texel);
+						else
+							memcpy(&cam->screenspace_px[offset * 4], &texel, 4);
+
+						cam->screenspace_zb[offset] = distance;
+					}
+				}
+			}
+		}
+
+		// Draw a transparent face, blending it over whatever is already in the
+		// frame buffer. The depth buffer is tested but not written, so faces
+		// must be drawn back to front.
+		void draw_face_blended(const Face &face){
+			trace_face(face);
+
+			if(y_min >= y_max)
+				return;
+
+			if(cam->indexed){
+				draw_face_dithered(face);
+				return;
+			}
+
+			const byte_t fill_black_data[4] = { 0x00, 0x00, 0x00, face.fill[3] };
+
+			for(int line = y_min; line <= y_max; line++){
+				pixel bounds = scanlines[line];
+				coord coord_left = scanlines_coords[2 * line];
+				coord coord_delta = (scanlines_coords[2 * line + 1] - coord_left) / (bounds.y - bounds.x);
+				bool edge_line = ((line == y_min) || (line == y_max));
+
+				int x_start = ((bounds.x + 1 < 0) ? 0 : (bounds.x + 1));
+				int x_end = ((bounds.y > cam->w) ? cam->w : bounds.y);
+
+				// Collect runs of visible pixels sharing a color, and blend
+				// each run in one go.
+				int run_start = -1;
+				const byte_t *run_color = NULL;
+
+				for(int x = x_start; x <= x_end; x++){
+					const byte_t *color = NULL;
+
+					if(x < x_end){
+						double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+						if(distance < cam->screenspace_zb[cam->w * line + x])
+							color = ((edge_line || (x == (bounds.x + 1)) || (x == (bounds.y - 1))) ? fill_black_data : face.fill);
+
+						// Textured pixels are blended one at a time, with the
+						// face's alpha.
+						if(face.tex && (color == face.fill)){
+							double u, v;
+							byte_t texel[4];
+
+							uv_at(line, x, u, v);
+							uint32_t sample = face.tex->sample(0, u, v);
+							memcpy(texel, &sample, 4);
+							texel[3] = face.fill[3];
+
+							blend_span(&cam->screenspace_px[(cam->w * line + x) * 4], 1, texel);
+							color = NULL;
+						}
+					}
+
+					if(color != run_color){
+						if(run_color)
+							blend_span(&cam->screenspace_px[(cam->w * line + run_start) * 4], x - run_start, run_color);
+
+						run_start = x;
+						run_color = color;
+					}
+				}
+			}
+		}
+
+		// Palette colors can't be blended, so indexed cameras draw
+		// transparent faces with an ordered dither pattern instead, covering
+		// a share of the pixels in proportion to the face's alpha.
+		void draw_face_dithered(const Face &face){
+			static const byte_t bayer[4][4] = {
+				{ 0x08, 0x88, 0x28, 0xa8 },
+				{ 0xc8, 0x48, 0xe8, 0x68 },
+				{ 0x38, 0xb8, 0x18, 0x98 },
+				{ 0xf8, 0x78, 0xd8, 0x58 }
+			};
+			const byte_t black[4] = { 0x00, 0x00, 0x00, 0xff };
+			const byte_t black_ix = Camera::quantize(black);
+			const byte_t fill_ix = Camera::quantize(face.fill);
+
+			for(int line = y_min; line <= y_max; line++){
+				pixel bounds = scanlines[line];
+				coord coord_left = scanlines_coords[2 * line];
+				coord coord_delta = (scanlines_coords[2 * line + 1] - coord_left) / (bounds.y - bounds.x);
+				bool edge_line = ((line == y_min) || (line == y_max));
+
+				int x_start = ((bounds.x + 1 < 0) ? 0 : (bounds.x + 1));
+				int x_end = ((bounds.y > cam->w) ? cam->w : bounds.y);
+
+				for(int x = x_start; x < x_end; x++){
+					if(face.fill[3] < bayer[line & 3][x & 3])
+						continue;
+
+					const unsigned int offset = (cam->w * line + x);
+					double distance = cam->pos.distance_to(coord_left + (coord_delta * (x - bounds.x)));
+
+					if(distance >= cam->screenspace_zb[offset])
+						continue;
+
+					if(edge_line || (x == (bounds.x + 1)) || (x == (bounds.y - 1))){
+						cam->screenspace_ix[offset] = black_ix;
+					} else if(face.tex){
+						double u, v;
+
+						uv_at(line, x, u, v);
+						cam->screenspace_ix[offset] = Camera::quantize(face.tex->sample(0, u, v));
+					} else {
+						cam->screenspace_ix[offset] = fill_ix;
+					}
+				}
+			}
+		}
+
+		// Draw all opaque faces followed by their borders. Transparent faces
+		// are left for the blended pass in Scene3D::draw. In wireframe mode
+		// only the edges are drawn.
+		virtual void draw(int ticks){
+			if(clip && ticks)
+				animate(ticks / 1000.0);
+
+			populateScreenspace();
+
+			if(!cam->wireframe)
+				for(const Face &face : faces)
+					if(!face.transparent())
+						draw_face(face);
+
+			if(outline || cam->wireframe)
+				draw_edges();
+		}
+	};
+
+	// Vertex animation for a mesh, loaded from a .anim asset exported along
+	// with the .mesh. Each keyframe holds the offset of every vertex from
+	// the rest pose as 16-bit integers, in units of scale:
+	//
+	//   fps 12
+	//   scale 0.0002
+	//   frame
+	//   { 0 120 -4 } # Vert   0
+	//   ...
+	//   frame
+	//   ...
+	//
+	// Vertices are listed as numbered in the .mesh file, and are matched up
+	// with the mesh's vertices after it was welded and reordered.
+	struct Clip {
+		double fps = 12;
+		float scale = 1;
+		int frames = 0, verts = 0;
+
+		// Offsets for every frame, each padded to a multiple of 8 values.
+		vector<int16_t> deltas;
+		int stride = 0;
+
+		inline const int16_t *frame(const int &k) const {
+			return &deltas[k * stride];
+		}
+
+		static Clip *load(asset::id id, const Mesh *mesh){
+			return load(FileLoader::name(id), mesh);
+		}
+		static Clip *load(const string &fname, const Mesh *mesh){
+			FileLoader *fl = FileLoader::get(fname);
+
+			if(!fl)
+				return NULL;
+
+			const int verts = mesh->vertex_count();
+			Clip *clip = new Clip();
+			stringstream in(fl->text());
+			string line;
+			int source = -1;
+
+			clip->verts = verts;
+			clip->stride = (3 * verts + 7) & ~7;
+
+			while(getline(in, line)){
+				line = line.substr(0, line.find('#'));
+
+				stringstream ls(line);
+				string word;
+
+				if(!(ls >> word))
+					continue;
+
+				if(word == "fps"){
+					ls >> clip->fps;
+				} else if(word == "scale"){
+					ls >> clip->scale;
+				} else if(word == "frame"){
+					clip->frames++;
+					clip->deltas.resize(clip->frames * clip->stride, 0);
+					source = 0;
+				} else if((word == "{") && (source >= 0)){
+					int d[3] = { 0, 0, 0 };
+
+					ls >> d[0] >> d[1] >> d[2];
+
+					// With no map, the mesh wasn't renumbered.
+					int v = (mesh->source_map.empty() ? source : ((source < (int) mesh->source_map.size()) ? mesh->source_map[source] : -1));
+
+					if((v >= 0) && (v < verts))
+						for(int i = 0; i < 3; i++)
+							clip->deltas[(clip->frames - 1) * clip->stride + 3 * v + i] = d[i];
+
+					source++;
+				}
+			}
+
+			if(!clip->frames){
+				cout << "Animation has no frames: " << fname << endl;
+				delete clip;
+
+				return NULL;
+			}
+
+			return clip;
+		}
+	};
+
+	// A stand-in for a distant mesh: a small sprite of the mesh, with depth,
+	// which is drawn as a single screen-aligned quad. Sprites are captured
+	// lazily for a handful of view directions around the mesh, and a sprite
+	// is captured again once the view has turned far enough from the
+	// direction it was captured at.
+	class Impostor {
+		struct Sprite {
+			coord dir;
+			double distance;
+			unsigned int revision;
+
+			// BGRA texels, and each texel's depth relative to the distance
+			// the sprite was captured at. Empty texels have zero alpha.
+			vector<byte_t> px;
+			vector<float> depth;
+		};
+
+		Mesh *mesh;
+		Camera *icam;
+		map<int, Sprite> sprites;
+
+		// Whether the mesh has any transparent faces, as of a revision.
+		bool transparent = false;
+		unsigned int transparent_revision = 0;
+
+		// Render the mesh from a camera looking at its center from dir, at
+		// the given distance, framing the bounding sphere.
+		void capture(Sprite &sprite, const coord &dir, const double &distance){
+			const byte_t empty[4] = { 0, 0, 0, 0 };
+			Camera *cam_orig = mesh->cam;
+
+			icam->pos = mesh->bound_center + (dir * distance);
+			icam->point = dir * -1.0;
+			icam->maxangle_w = icam->maxangle_h = asin(min(1.0, mesh->bound_radius / distance));
+			icam->cache();
+			icam->clear(empty);
+
+			mesh->cam = icam;
+			mesh->draw(0);
+			mesh->cam = cam_orig;
+
+			sprite.dir = dir;
+			sprite.distance = distance;
+			sprite.revision = mesh->revision;
+			sprite.px = icam->screenspace_px;
+			sprite.depth.resize(IMPOSTOR_SIZE * IMPOSTOR_SIZE);
+			for(int i = 0; i < (IMPOSTOR_SIZE * IMPOSTOR_SIZE); i++)
+				sprite.depth[i] = icam->screenspace_zb[i] - distance;
+		}
+
+	public:
+		Impostor(Mesh *mesh){
+			this->mesh = mesh;
+
+			icam = new Camera(mesh->bound_center, (coord){ 1, 0, 0 }, IMPOSTOR_SIZE, IMPOSTOR_SIZE, PI / 4);
+			transparent_revision = mesh->revision - 1;
+		}
+
+		~Impostor(){
+			delete icam;
+		}
+
+		// Sprites are copied over the frame rather than blended, so meshes
+		// with transparent faces can't be drawn as impostors.
+		bool usable(){
+			if(transparent_revision != mesh->revision){
+				transparent = false;
+				for(const Mesh::Face &face : mesh->faces)
+					transparent = (transparent || face.transparent());
+
+				transparent_revision = mesh->revision;
+			}
+
+			return !transparent;
+		}
+
+		void draw(){
+			Camera *cam = mesh->cam;
+			coord rel = cam->pos - mesh->bound_center;
+			double distance = rel.distance_to((coord){ 0, 0, 0 });
+
+			if(distance <= mesh->bound_radius)
+				return;
+
+			coord dir = rel * (1.0 / distance);
+
+			// Pick the sprite slot for this direction, and capture it if it's
+			// missing, stale, or too far off the current view.
+			int slot_yaw = (int)(dir.angle_xz().getValue() / (2 * PI) * IMPOSTOR_YAW_SLOTS) % IMPOSTOR_YAW_SLOTS;
+			int slot_pitch = (int)((asin(max(-1.0, min(1.0, dir.y))) / PI + 0.5) * IMPOSTOR_PITCH_SLOTS);
+			Sprite &sprite = sprites[slot_pitch * IMPOSTOR_YAW_SLOTS + slot_yaw];
+
+			if(
+				sprite.px.empty() || (sprite.revision != mesh->revision) ||
+				(acos(max(-1.0, min(1.0, sprite.dir.x * dir.x + sprite.dir.y * dir.y + sprite.dir.z * dir.z))) > IMPOSTOR_THRESHOLD)
+			)
+				capture(sprite, dir, distance);
+
+			// Size of the quad on screen, from the angle the sphere subtends.
+			pixel center = cam->vertex_screenspace(mesh->bound_center);
+			double angle = asin(min(1.0, mesh->bound_radius / distance));
+			int size = (int)(angle / cam->maxangle_w * cam->w / 2) * 2;
+
+			if(size <= 0)
+				return;
+
+			int x0 = center.x - size / 2, y0 = center.y - size / 2;
+			int x_start = max(0, x0), x_end = min(cam->w, x0 + size);
+			int y_start = max(0, y0), y_end = min(cam->h, y0 + size);
+
+			for(int y = y_start; y < y_end; y++){
+				const int row = ((y - y0) * IMPOSTOR_SIZE / size) * IMPOSTOR_SIZE;
+
+				for(int x = x_start; x < x_end; x++){
+					const int texel = row + ((x - x0) * IMPOSTOR_SIZE / size);
+
+					if(!sprite.px[texel * 4 + 3])
+						continue;
+
+					const int offset = (cam->w * y + x);
+					double depth = distance + sprite.depth[texel];
+
+					if(depth < cam->screenspace_zb[offset]){
+						if(cam->indexed)
+							cam->screenspace_ix[offset] = Camera::quantize(&sprite.px[texel * 4]);
+						else
+							memcpy(&cam->screenspace_px[offset * 4], &sprite.px[texel * 4], 4);
+
+						// Sprites are already colored, so resolving must leave
+						// this pixel alone.
+						if(cam->deferred)
+							cam->screenspace_id[offset] = 0;
+
+						cam->screenspace_zb[offset] = depth;
+					}
+				}
+			}
+		}
+	};
+
+	// Terrain built from a heightmap image, where brighter pixels are
+	// higher. The terrain is cut into a quadtree of square chunks, and every
+	// node of the tree has its own mesh of TERRAIN_CHUNK_CELLS cells across,
+	// so a node is a coarser copy of its four children. Each frame the tree
+	// is walked near to far, skipping nodes outside the view, and stopping
+	// at the first node which is far enough away for its level of detail.
+	// Neighboring chunks at different levels don't share every vertex along
+	// their seam, so each chunk hangs a skirt down from its border to hide
+	// the cracks.
+	//
+	// Every level of the tree is built up front, which is about a third
+	// more than the finest level alone. A chunk is 192 faces and comes to
+	// about 28 KB, so a 65 pixel square heightmap (85 chunks) costs about
+	// 2.4 MB, and a 257 pixel one (1365 chunks) about 38 MB.
+	class Terrain {
+		struct Node {
+			double x0, z0, size;
+			coord center;
+			double radius;
+			Mesh *mesh;
+			Node *children[4] = { NULL, NULL, NULL, NULL };
+		};
+
+		Camera *cam;
+		vector<float> heights;
+		int hm_w = 0, hm_h = 0;
+		coord origin;
+		double size, height;
+		Node *root = NULL;
+
+		// Height of a heightmap sample, clamped to the edges.
+		inline double sample(int x, int z) const {
+			x = max(0, min(hm_w - 1, x));
+			z = max(0, min(hm_h - 1, z));
+
+			return heights[z * hm_w + x];
+		}
+
+		Mesh *build_chunk(const double &x0, const double &z0, const double &chunk_size){
+			const int n = TERRAIN_CHUNK_CELLS;
+			const double cell = chunk_size / n;
+			const double skirt = chunk_size / 4;
+			vector<coord> vertices;
+			vector<Mesh::Face> faces;
+
+			for(int j = 0; j <= n; j++)
+				for(int i = 0; i <= n; i++)
+					vertices.push_back((coord){ x0 + i * cell, height_at(x0 + i * cell, z0 + j * cell), z0 + j * cell });
+
+			// Two triangles per cell, with the diagonal alternating so the
+			// surface doesn't lean one way.
+			for(int j = 0; j < n; j++){
+				for(int i = 0; i < n; i++){
+					int a = j * (n + 1) + i, b = a + 1, c = a + (n + 1), d = c + 1;
+
+					if((i + j) & 1){
+						add_face(faces, vertices, a, b, d);
+						add_face(faces, vertices, a, d, c);
+					} else {
+						add_face(faces, vertices, a, b, c);
+						add_face(faces, vertices, b, d, c);
+					}
+				}
+			}
+
+			// Skirts, around the border in order, colored like the face above.
+			vector<int> border;
+			for(int i = 0; i < n; i++)
+				border.push_back(i);
+			for(int j = 0; j < n; j++)
+				border.push_back(j * (n + 1) + n);
+			for(int i = n; i > 0; i--)
+				border.push_back(n * (n + 1) + i);
+			for(int j = n; j > 0; j--)
+				border.push_back(j * (n + 1));
+
+			const int first = vertices.size();
+			for(int id : border)
+				vertices.push_back(vertices[id] + (coord){ 0, -skirt, 0 });
+
+			for(int k = 0, len = border.size(); k < len; k++){
+				int next = ((k + 1) % len);
+				byte_t fill[4];
+
+				// Copied, since adding faces can move the one it's from.
+				memcpy(fill, faces[skirt_face(k, n)].fill, 4);
+
+				faces.push_back(Mesh::Face({ border[k], border[next], first + next }, fill));
+				faces.push_back(Mesh::Face({ border[k], first + next, first + k }, fill));
+			}
+
+			Mesh *mesh = new Mesh(cam, vertices, faces);
+			mesh->outline = false;
+			mesh->quantize();
+
+			return mesh;
+		}
+
+		// The surface face touching the k-th border edge of a chunk.
+		static int skirt_face(const int &k, const int &n){
+			int side = k / n, i = k % n;
+			int cell;
+
+			switch(side){
+				case 0: cell = i; break;
+				case 1: cell = i * n + (n - 1); break;
+				case 2: cell = (n - 1) * n + (n - 1 - i); break;
+				default: cell = (n - 1 - i) * n; break;
+			}
+
+			return cell * 2;
+		}
+
+		// Add a triangle, shaded by its height and its angle to the light.
+		// Steep faces are rock regardless of height.
+		void add_face(vector<Mesh::Face> &faces, const vector<coord> &vertices, const int &a, const int &b, const int &c){
+			const coord e1 = vertices[b] - vertices[a], e2 = vertices[c] - vertices[a];
+			coord nrm = {
+				e1.y * e2.z - e1.z * e2.y,
+				e1.z * e2.x - e1.x * e2.z,
+				e1.x * e2.y - e1.y * e2.x
+			};
+			double len = nrm.distance_to((coord){ 0, 0, 0 });
+			nrm = nrm * ((nrm.y < 0 ? -1.0 : 1.0) / (len ? len : 1));
+
+			const double t = ((vertices[a].y + vertices[b].y + vertices[c].y) / 3 - origin.y) / (height ? height : 1);
+			const double light = 0.55 + 0.45 * max(0.0, nrm.x * 0.4 + nrm.y * 0.8 + nrm.z * 0.45);
+			int rgb[3];
+
+			if((nrm.y < 0.7) || ((t > 0.4) && (t < 0.75))){
+				rgb[0] = 0x7a; rgb[1] = 0x65; rgb[2] = 0x4a;
+			} else if(t >= 0.75){
+				rgb[0] = 0xee; rgb[1] = 0xee; rgb[2] = 0xf0;
+			} else {
+				rgb[0] = 0x3a; rgb[1] = 0x7d; rgb[2] = 0x2c;
+			}
+
+			const byte_t fill[4] = {
+				(byte_t)(rgb[2] * light),
+				(byte_t)(rgb[1] * light),
+				(byte_t)(rgb[0] * light),
+				0xff
+			};
+
+			faces.push_back(Mesh::Face({ a, b, c }, fill));
+		}
+
+		Node *build(const double &x0, const double &z0, const double &node_size, const int &depth){
+			Node *node = new Node();
+
+			node->x0 = x0;
+			node->z0 = z0;
+			node->size = node_size;
+			node->mesh = build_chunk(x0, z0, node_size);
+			node->center = node->mesh->bound_center;
+			node->radius = node->mesh->bound_radius;
+
+			if(depth > 0){
+				double half = node_size / 2;
+
+				node->children[0] = build(x0, z0, half, depth - 1);
+				node->children[1] = build(x0 + half, z0, half, depth - 1);
+				node->children[2] = build(x0, z0 + half, half, depth - 1);
+				node->children[3] = build(x0 + half, z0 + half, half, depth - 1);
+			}
+
+			return node;
+		}
+
+		// Build the tree deep enough that the finest chunks have about one
+		// cell per heightmap pixel.
+		void build_tree(){
+			int depth = 0;
+			while((TERRAIN_CHUNK_CELLS << depth) < (max(hm_w, hm_h) - 1))
+				depth++;
+
+			root = build(origin.x, origin.z, size, depth);
+		}
+
+		void destroy(Node *node){
+			if(!node)
+				return;
+
+			for(Node *child : node->children)
+				destroy(child);
+
+			delete node->mesh;
+			delete node;
+		}
+
+		void select(Node *node, list<Mesh*> &chunks) const {
+			if(!cam->sphere_visible(node->center, node->radius))
+				return;
+
+			double distance = cam->pos.distance_to(node->center) - node->radius;
+
+			if(!node->children[0] || (distance > node->size * TERRAIN_LOD_FACTOR)){
+				chunks.push_back(node->mesh);
+				return;
+			}
+
+			// Visit the children nearest first.
+			Node *order[4];
+			double key[4];
+
+			for(int i = 0; i < 4; i++){
+				order[i] = node->children[i];
+				key[i] = cam->pos.distance_to(order[i]->center);
+
+				for(int j = i; (j > 0) && (key[j - 1] > key[j]); j--){
+					swap(key[j], key[j - 1]);
+					swap(order[j], order[j - 1]);
+				}
+			}
+
+			for(Node *child : order)
+				select(child, chunks);
+		}
+
+	public:
+		// Build terrain from heights between 0 and 1, w by h samples in rows
+		// along x, covering a square of size world units on x and z from
+		// origin, and rising up to height above it.
+		Terrain(Camera *cam, const vector<float> &heights, const int &w, const int &h, const coord &origin, const double &size, const double &height){
+			this->cam = cam;
+			this->heights = heights;
+			this->hm_w = w;
+			this->hm_h = h;
+			this->origin = origin;
+			this->size = size;
+			this->height = height;
+
+			build_tree();
+		}
+
+		// Build terrain from a heightmap asset, where brighter pixels are
+		// higher.
+		Terrain(Camera *cam, const string &fname, const coord &origin, const double &size, const double &height){
+			this->cam = cam;
+			this->origin = origin;
+			this->size = size;
+			this->height = height;
+
+			FileLoader *fl = FileLoader::get(fname);
+			SDL_Surface *sf = (fl ? fl->surface() : NULL);
+
+			if(!sf){
+				cout << "Failed to load heightmap: " << fname << endl;
+				return;
+			}
+
+			SDL_Surface *conv = SDL_ConvertSurfaceFormat(sf, SDL_PIXELFORMAT_ARGB8888, 0);
+
+			hm_w = conv->w;
+			hm_h = conv->h;
+			heights.resize(hm_w * hm_h);
+
+			SDL_LockSurface(conv);
+			for(int y = 0; y < hm_h; y++){
+				const uint32_t *row = (const uint32_t*)((byte_t*) conv->pixels + y * conv->pitch);
+
+				for(int x = 0; x < hm_w; x++)
+					heights[y * hm_w + x] = (((row[x] >> 16) & 0xff) + ((row[x] >> 8) & 0xff) + (row[x] & 0xff)) / (3.0f * 0xff);
+			}
+			SDL_UnlockSurface(conv);
+			SDL_FreeSurface(conv);
+
+			build_tree();
+		}
+
+		~Terrain(){
+			destroy(root);
+		}
+
+		// Height of the ground at a point on the x,z plane, interpolated
+		// between heightmap pixels.
+		double height_at(const double &x, const double &z) const {
+			if(heights.empty())
+				return origin.y;
+
+			double fx = (x - origin.x) / size * (hm_w - 1);
+			double fz = (z - origin.z) / size * (hm_h - 1);
+			int ix = (int) floor(fx), iz = (int) floor(fz);
+			double tx = fx - ix, tz = fz - iz;
+
+			double top = sample(ix, iz) + (sample(ix + 1, iz) - sample(ix, iz)) * tx;
+			double bottom = sample(ix, iz + 1) + (sample(ix + 1, iz + 1) - sample(ix, iz + 1)) * tx;
+
+			return origin.y + (top + (bottom - top) * tz) * height;
+		}
+
+		// The chunks to draw this frame, nearest first.
+		void select(list<Mesh*> &chunks) const {
+			if(root)
+				select(root, chunks);
+		}
+	};
+
+	// Collision against mesh faces for a walking camera. The camera is a
+	// capsule hanging COLLIDE_HEIGHT below the eye, lifted COLLIDE_STEP off
+	// the ground so that it steps up onto low ledges instead of stopping.
+	// Faces are split into triangles and filed into a spatial hash of
+	// COLLIDE_CELL sized cubes, so a move only tests the few triangles in
+	// the cells around the capsule.
+	class Collider {
+		struct Triangle {
+			coord a, b, c, normal;
+		};
+
+		vector<Triangle> triangles;
+		vector<int> buckets[COLLIDE_BUCKETS];
+
+		// Stamp of the last query to see each triangle, so triangles filed
+		// in more than one cell are only tested once per query.
+		vector<unsigned int> seen;
+		unsigned int query = 0;
+		vector<int> found;
+
+		static inline double dot(const coord &a, const coord &b){
+			return a.x * b.x + a.y * b.y + a.z * b.z;
+		}
+
+		static inline coord cross(const coord &a, const coord &b){
+			return (coord){
+				a.y * b.z - a.z * b.y,
+				a.z * b.x - a.x * b.z,
+				a.x * b.y - a.y * b.x
+			};
+		}
+
+		static inline int cell(const double &v){
+			return (int) floor(v / COLLIDE_CELL);
+		}
+
+		inline vector<int> &bucket(const int &x, const int &y, const int &z){
+			return buckets[((x * 73856093) ^ (y * 19349663) ^ (z * 83492791)) & (COLLIDE_BUCKETS - 1)];
+		}
+
+		// Collect the triangles filed in every cell touching a box.
+		void gather(const coord &lo, const coord &hi){
+			found.clear();
+			query++;
+
+			for(int x = cell(lo.x); x <= cell(hi.x); x++)
+				for(int y = cell(lo.y); y <= cell(hi.y); y++)
+					for(int z = cell(lo.z); z <= cell(hi.z); z++)
+						for(int t : bucket(x, y, z)){
+							if(seen[t] == query)
+								continue;
+
+							seen[t] = query;
+							found.push_back(t);
+						}
+		}
+
+		// Closest point on a triangle to p, from Ericson's Real-Time
+		// Collision Detection.
+		static coord closest_on_triangle(const coord &p, const Triangle &tri){
+			const coord ab = tri.b - tri.a, ac = tri.c - tri.a, ap = p - tri.a;
+			double d1 = dot(ab, ap), d2 = dot(ac, ap);
+
+			if((d1 <= 0) && (d2 <= 0))
+				return tri.a;
+
+			const coord bp = p - tri.b;
+			double d3 = dot(ab, bp), d4 = dot(ac, bp);
+
+			if((d3 >= 0) && (d4 <= d3))
+				return tri.b;
+
+			double vc = d1 * d4 - d3 * d2;
+			if((vc <= 0) && (d1 >= 0) && (d3 <= 0))
+				return tri.a + ab * (d1 / (d1 - d3));
+
+			const coord cp = p - tri.c;
+			double d5 = dot(ab, cp), d6 = dot(ac, cp);
+
+			if((d6 >= 0) && (d5 <= d6))
+				return tri.c;
+
+			double vb = d5 * d2 - d1 * d6;
+			if((vb <= 0) && (d2 >= 0) && (d6 <= 0))
+				return tri.a + ac * (d2 / (d2 - d6));
+
+			double va = d3 * d6 - d5 * d4;
+			if((va <= 0) && ((d4 - d3) >= 0) && ((d5 - d6) >= 0))
+				return tri.b + (tri.c - tri.b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+			double denom = 1.0 / (va + vb + vc);
+			return tri.a + ab * (vb * denom) + ac * (vc * denom);
+		}
+
+		// Closest points between segments p1-q1 and p2-q2.
+		static void closest_segments(const coord &p1, const coord &q1, const coord &p2, const coord &q2, coord &c1, coord &c2){
+			const coord d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+			double a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+			double s = 0, t = 0;
+
+			if(a <= 1e-12){
+				t = ((e > 1e-12) ? max(0.0, min(1.0, f / e)) : 0);
+			} else {
+				double c = dot(d1, r);
+
+				if(e <= 1e-12){
+					s = max(0.0, min(1.0, -c / a));
+				} else {
+					double b = dot(d1, d2), denom = a * e - b * b;
+
+					s = ((denom > 1e-12) ? max(0.0, min(1.0, (b * f - c * e) / denom)) : 0);
+					t = (b * s + f) / e;
+
+					if(t < 0){
+						t = 0;
+						s = max(0.0, min(1.0, -c / a));
+					} else if(t > 1){
+						t = 1;
+						s = max(0.0, min(1.0, (b - c) / a));
+					}
+				}
+			}
+
+			c1 = p1 + d1 * s;
+			c2 = p2 + d2 * t;
+		}
+
+		// Closest points between the segment p-q and a triangle. Returns the
+		// squared distance between them, which is zero if the segment
+		// passes through the triangle.
+		static double closest_segment_triangle(const coord &p, const coord &q, const Triangle &tri, coord &on_seg, coord &on_tri){
+			const coord d = q - p;
+			double denom = dot(tri.normal, d);
+
+			// Where the segment crosses the triangle's plane, if inside it.
+			if(abs(denom) > 1e-12){
+				double t = dot(tri.normal, tri.a - p) / denom;
+
+				if((t >= 0) && (t <= 1)){
+					coord hit = p + d * t;
+
+					if(dot(cross(tri.b - tri.a, hit - tri.a), tri.normal) >= 0 &&
+						dot(cross(tri.c - tri.b, hit - tri.b), tri.normal) >= 0 &&
+						dot(cross(tri.a - tri.c, hit - tri.c), tri.normal) >= 0
+					){
+						on_seg = on_tri = hit;
+						return 0;
+					}
+				}
+			}
+
+			double best = -1;
+			const coord ends[2] = { p, q };
+			const coord *edges[3][2] = {
+				{ &tri.a, &tri.b }, { &tri.b, &tri.c }, { &tri.c, &tri.a }
+			};
+
+			for(const coord &end : ends){
+				coord c = closest_on_triangle(end, tri);
+				double dist = dot(c - end, c - end);
+
+				if((best < 0) || (dist < best)){
+					best = dist;
+					on_seg = end;
+					on_tri = c;
+				}
+			}
+
+			for(auto &edge : edges){
+				coord c1, c2;
+
+				closest_segments(p, q, *edge[0], *edge[1], c1, c2);
+				double dist = dot(c2 - c1, c2 - c1);
+
+				if(dist < best){
+					best = dist;
+					on_seg = c1;
+					on_tri = c2;
+				}
+			}
+
+			return best;
+		}
+
+		// Push the capsule for an eye position out of every triangle it
+		// overlaps. Returns true if anything was touched.
+		bool resolve(coord &eye){
+			const double r = COLLIDE_RADIUS;
+			coord top = eye, bottom = eye - (coord){ 0, COLLIDE_HEIGHT - COLLIDE_STEP - r, 0 };
+			bool touched = false;
+
+			gather(
+				(coord){ eye.x - r, bottom.y - r, eye.z - r },
+				(coord){ eye.x + r, top.y + r, eye.z + r }
+			);
+
+			for(int t : found){
+				const Triangle &tri = triangles[t];
+				coord on_seg, on_tri;
+				double dist_sq = closest_segment_triangle(bottom, top, tri, on_seg, on_tri);
+
+				if(dist_sq >= r * r)
+					continue;
+
+				double dist = sqrt(dist_sq);
+				coord away;
+
+				if(dist > 1e-9){
+					away = (on_seg - on_tri) * (1.0 / dist);
+				} else {
+					// The segment passes through the face, so push it back to
+					// the side its middle is on.
+					coord mid = (top + bottom) * 0.5;
+					away = tri.normal * ((dot(tri.normal, mid - tri.a) < 0) ? -1.0 : 1.0);
+				}
+
+				coord push = away * (r - dist + 1e-4);
+				eye += push;
+				top += push;
+				bottom += push;
+				touched = true;
+			}
+
+			return touched;
+		}
+
+	public:
+		// Follow the ground up and down steps while walking.
+		bool follow_ground = true;
+
+		Collider(const list<Mesh*> &meshes){
+			for(Mesh *mesh : meshes){
+				if(!mesh)
+					continue;
+
+				for(const Mesh::Face &face : mesh->faces){
+					if(!face.fill[3] || (face.vertIds.size() < 3))
+						continue;
+
+					// Fan the face out into triangles.
+					const coord a = mesh->vertex(face.vertIds[0]);
+
+					for(size_t i = 2; i < face.vertIds.size(); i++){
+						Triangle tri = { a, mesh->vertex(face.vertIds[i - 1]), mesh->vertex(face.vertIds[i]), { 0, 0, 0 } };
+						coord n = cross(tri.b - tri.a, tri.c - tri.a);
+						double len = sqrt(dot(n, n));
+
+						if(len < 1e-12)
+							continue;
+
+						tri.normal = n * (1.0 / len);
+						add(tri);
+					}
+				}
+			}
+
+			seen.assign(triangles.size(), 0);
+		}
+
+		void add(const Triangle &tri){
+			const int id = triangles.size();
+			coord lo = {
+				min(tri.a.x, min(tri.b.x, tri.c.x)),
+				min(tri.a.y, min(tri.b.y, tri.c.y)),
+				min(tri.a.z, min(tri.b.z, tri.c.z))
+			};
+			coord hi = {
+				max(tri.a.x, max(tri.b.x, tri.c.x)),
+				max(tri.a.y, max(tri.b.y, tri.c.y)),
+				max(tri.a.z, max(tri.b.z, tri.c.z))
+			};
+
+			triangles.push_back(tri);
+
+			for(int x = cell(lo.x); x <= cell(hi.x); x++)
+				for(int y = cell(lo.y); y <= cell(hi.y); y++)
+					for(int z = cell(lo.z); z <= cell(hi.z); z++){
+						vector<int> &b = bucket(x, y, z);
+
+						// Neighboring cells can share a bucket.
+						if(b.empty() || (b.back() != id))
+							b.push_back(id);
+					}
+		}
+
+		// Height of the highest face directly below a point, searching down
+		// at most range. Returns false if there isn't one.
+		bool ground_at(const coord &p, const double &range, double &height){
+			bool hit = false;
+
+			gather((coord){ p.x, p.y - range, p.z }, p);
+
+			for(int t : found){
+				const Triangle &tri = triangles[t];
+
+				// Skip walls.
+				if(abs(tri.normal.y) < 1e-6)
+					continue;
+
+				// Barycentric coordinates of p on the x,z plane.
+				double det = (tri.b.z - tri.c.z) * (tri.a.x - tri.c.x) + (tri.c.x - tri.b.x) * (tri.a.z - tri.c.z);
+				if(abs(det) < 1e-12)
+					continue;
+
+				double l1 = ((tri.b.z - tri.c.z) * (p.x - tri.c.x) + (tri.c.x - tri.b.x) * (p.z - tri.c.z)) / det;
+				double l2 = ((tri.c.z - tri.a.z) * (p.x - tri.c.x) + (tri.a.x - tri.c.x) * (p.z - tri.c.z)) / det;
+				double l3 = 1 - l1 - l2;
+
+				if((l1 < 0) || (l2 < 0) || (l3 < 0))
+					continue;
+
+				double y = l1 * tri.a.y + l2 * tri.b.y + l3 * tri.c.y;
+
+				if((y <= p.y) && (y >= (p.y - range)) && (!hit || (y > height))){
+					height = y;
+					hit = true;
+				}
+			}
+
+			return hit;
+		}
+
+		// Move an eye position by delta, sliding along anything in the way,
+		// and return where it ends up.
+		coord move(const coord &eye, const coord &delta){
+			coord to = eye + delta;
+
+			for(int i = 0; (i < COLLIDE_ITERATIONS) && resolve(to); i++);
+
+			if(follow_ground){
+				double ground;
+				coord feet = to - (coord){ 0, COLLIDE_HEIGHT, 0 };
+
+				if(ground_at(feet + (coord){ 0, COLLIDE_STEP, 0 }, 2 * COLLIDE_STEP, ground))
+					to.y = ground + COLLIDE_HEIGHT;
+			}
+
+			return to;
+		}
+	};
+
+	// A world too big to keep in memory at once, cut into square regions on
+	// the x,z plane, each of them a mesh asset. It's described by a .world
+	// asset, which gives the size of a region and then one line for each
+	// region with its column, row and mesh. A region's mesh may be followed
+	// by an offset to move it by, so one mesh can be placed many times:
+	//
+	//   cell 32
+	//   0 0 models/world/0_0.mesh
+	//   1 0 models/world/1_0.mesh
+	//   2 0 models/hut.mesh 80 0 16
+	//
+	// Regions within radius of the camera are loaded on a background thread,
+	// nearest first. Loaded regions stay in memory after the camera leaves
+	// until the total passes the budget, and then the least recently used
+	// are dropped. The main thread only takes finished meshes off a list and
+	// puts dropped ones on another, so parsing and freeing never stall a
+	// frame.
+	class World {
+		enum chunk_state { CHUNK_IDLE, CHUNK_QUEUED, CHUNK_LOADING, CHUNK_READY };
+
+		struct Chunk {
+			int x, z;
+			string fname;
+			coord offset = { 0, 0, 0 };
+			chunk_state state = CHUNK_IDLE;
+			Mesh *mesh = NULL;
+			size_t bytes = 0;
+			unsigned int used = 0;
+		};
+
+		Camera *cam;
+		map<pair<int, int>, Chunk> chunks;
+		double cell = 32, radius;
+		size_t budget, resident = 0;
+		unsigned int frame = 0;
+
+		// Shared with the loader thread, under lock.
+		SDL_mutex *lock;
+		SDL_cond *wake;
+		SDL_Thread *thread = NULL;
+		list<Chunk*> requests, finished;
+		list<Mesh*> trash;
+		bool quit = false;
+
+		static int loader(void *data){
+			World *world = (World*) data;
+
+			SDL_LockMutex(world->lock);
+			while(!world->quit){
+				if(world->requests.empty() && world->trash.empty()){
+					SDL_CondWait(world->wake, world->lock);
+					continue;
+				}
+
+				// Free dropped meshes first, to make room.
+				list<Mesh*> trash;
+				trash.swap(world->trash);
+
+				if(!trash.empty()){
+					SDL_UnlockMutex(world->lock);
+					for(Mesh *mesh : trash)
+						delete mesh;
+					SDL_LockMutex(world->lock);
+
+					continue;
+				}
+
+				Chunk *chunk = world->requests.front();
+				string fname = chunk->fname;
+				coord offset = chunk->offset;
+
+				world->requests.pop_front();
+				chunk->state = CHUNK_LOADING;
+
+				SDL_UnlockMutex(world->lock);
+				Mesh *mesh = Mesh::load(world->cam, fname);
+				size_t bytes = 0;
+
+				if(mesh){
+					if(!(offset == (coord){ 0, 0, 0 }))
+						mesh->translate(offset);
+
+					bytes = mesh->memory();
+				}
+
+				SDL_LockMutex(world->lock);
+
+				chunk->mesh = mesh;
+				chunk->bytes = bytes;
+				world->finished.push_back(chunk);
+			}
+			SDL_UnlockMutex(world->lock);
+
+			return 0;
+		}
+
+		inline double distance_to(const Chunk &chunk) const {
+			double cx = (chunk.x + 0.5) * cell, cz = (chunk.z + 0.5) * cell;
+
+			return sqrt(SQUARE(cx - cam->pos.x) + SQUARE(cz - cam->pos.z));
+		}
+
+		// Read the region list and start the loader.
+		void start(istream &in, const string &fname){
+			string line;
+
+			while(getline(in, line)){
+				stringstream ls(line);
+				string first;
+
+				if(!(ls >> first) || (first[0] == '#'))
+					continue;
+
+				if(first == "cell"){
+					ls >> cell;
+					continue;
+				}
+
+				Chunk chunk;
+				chunk.x = atoi(first.c_str());
+
+				if(!(ls >> chunk.z >> chunk.fname)){
+					cout << "World parsing error in [" << fname << "]: " << line << endl;
+					continue;
+				}
+
+				if(!(ls >> chunk.offset.x >> chunk.offset.y >> chunk.offset.z))
+					chunk.offset = (coord){ 0, 0, 0 };
+
+				chunks[make_pair(chunk.x, chunk.z)] = chunk;
+			}
+
+			lock = SDL_CreateMutex();
+			wake = SDL_CreateCond();
+			thread = SDL_CreateThread(loader, "world loader", this);
+		}
+
+	public:
+		// Regions are loaded while their centers are within radius of the
+		// camera on the x,z plane. budget is in bytes.
+		World(Camera *cam, const string &fname, const double &radius, const size_t &budget){
+			this->cam = cam;
+			this->radius = radius;
+			this->budget = budget;
+
+			FileLoader *fl = FileLoader::get(fname);
+
+			if(!fl){
+				cout << "Failed to load world: " << fname << endl;
+				return;
+			}
+
+			stringstream in(fl->text());
+			start(in, fname);
+		}
+
+		// A world described by text in the same form as a .world asset.
+		World(Camera *cam, istream &in, const double &radius, const size_t &budget){
+			this->cam = cam;
+			this->radius = radius;
+			this->budget = budget;
+
+			start(in, "(inline)");
+		}
+
+		~World(){
+			if(thread){
+				SDL_LockMutex(lock);
+				quit = true;
+				SDL_CondSignal(wake);
+				SDL_UnlockMutex(lock);
+
+				SDL_WaitThread(thread, NULL);
+				SDL_DestroyCond(wake);
+				SDL_DestroyMutex(lock);
+			}
+
+			for(auto &it : chunks)
+				if(it.second.mesh)
+					delete it.second.mesh;
+
+			for(Mesh *mesh : trash)
+				delete mesh;
+		}
+
+		// Take in finished regions, ask for the ones now in range, and drop
+		// the least recently used if over budget. Call once per frame.
+		void update(){
+			if(!thread)
+				return;
+
+			frame++;
+
+			SDL_LockMutex(lock);
+
+			for(Chunk *chunk : finished){
+				chunk->state = CHUNK_READY;
+				chunk->used = frame;
+				resident += chunk->bytes;
+			}
+			finished.clear();
+
+			// Queue everything in range which isn't loaded yet.
+			int x_lo = (int) floor((cam->pos.x - radius) / cell), x_hi = (int) floor((cam->pos.x + radius) / cell);
+			int z_lo = (int) floor((cam->pos.z - radius) / cell), z_hi = (int) floor((cam->pos.z + radius) / cell);
+
+			for(int x = x_lo; x <= x_hi; x++){
+				for(int z = z_lo; z <= z_hi; z++){
+					auto it = chunks.find(make_pair(x, z));
+
+					if((it == chunks.end()) || (distance_to(it->second) > radius))
+						continue;
+
+					Chunk &chunk = it->second;
+					chunk.used = frame;
+
+					if(chunk.state == CHUNK_IDLE){
+						chunk.state = CHUNK_QUEUED;
+						requests.push_back(&chunk);
+					}
+				}
+			}
+
+			// Forget requests which have gone out of range, and load the
+			// nearest first.
+			for(auto it = requests.begin(); it != requests.end();){
+				if((*it)->used != frame){
+					(*it)->state = CHUNK_IDLE;
+					it = requests.erase(it);
+				} else it++;
+			}
+			requests.sort([this](const Chunk *a, const Chunk *b){
+				return distance_to(*a) < distance_to(*b);
+			});
+
+			// Drop regions out of range, oldest first, until under budget.
+			while(resident > budget){
+				Chunk *oldest = NULL;
+
+				for(auto &it : chunks){
+					Chunk &chunk = it.second;
+
+					if((chunk.state == CHUNK_READY) && (chunk.used != frame) && (!oldest || (chunk.used < oldest->used)))
+						oldest = &chunk;
+				}
+
+				if(!oldest)
+					break;
+
+				if(oldest->mesh)
+					trash.push_back(oldest->mesh);
+
+				resident -= oldest->bytes;
+				oldest->mesh = NULL;
+				oldest->bytes = 0;
+				oldest->state = CHUNK_IDLE;
+			}
+
+			if(!requests.empty() || !trash.empty())
+				SDL_CondSignal(wake);
+
+			SDL_UnlockMutex(lock);
+		}
+
+		// The loaded regions in range and in view.
+		void select(list<Mesh*> &meshes) const {
+			if(!thread)
+				return;
+
+			SDL_LockMutex(lock);
+			for(auto &it : chunks){
+				const Chunk &chunk = it.second;
+
+				if((chunk.state == CHUNK_READY) && chunk.mesh && (chunk.used == frame) && cam->sphere_visible(chunk.mesh->bound_center, chunk.mesh->bound_radius))
+					meshes.push_back(chunk.mesh);
+			}
+			SDL_UnlockMutex(lock);
+		}
+
+		// Bytes held by loaded regions.
+		size_t memory() const {
+			return resident;
+		}
+	};
+
+	// Objects
+	list<Mesh*> drawable_meshes;
+
+	// Effects drawn into the frame buffer after opaque geometry, such as
+	// particles. These are owned by the caller.
+	list<Renderable*> effects;
+
+	// Collision for the camera, once built.
+	Collider *collider = NULL;
+
+	// Streamed world regions drawn along with the meshes, if any. Owned by
+	// the scene.
+	World *world = NULL;
+	list<Mesh*> world_chunks;
+
+	// Terrain drawn along with the meshes, if any. Owned by the scene.
+	Terrain *terrain = NULL;
+	list<Mesh*> terrain_chunks;
+
+	// Meshes whose bounding sphere is further than this from the camera are
+	// drawn as impostors. Zero disables impostors.
+	double impostor_distance = 0;
+	map<Mesh*, Impostor*> impostors;
+
+	// Meshes drawn with full geometry this frame.
+	list<Mesh*> meshes_drawn;
+
+	// Meshes by their slot in the visibility buffer, for deferred cameras.
+	vector<Mesh*> vis_meshes;
+
+	// Single mesh holding the geometry of every static mesh, once built.
+	Mesh *static_batch = NULL;
+
+	virtual ~Scene3D(){
+		for(auto it : impostors)
+			delete it.second;
+
+		if(static_batch)
+			delete static_batch;
+
+		if(terrain)
+			delete terrain;
+
+		if(world)
+			delete world;
+
+		if(collider)
+			delete collider;
+	}
+
+	// Build collision for the scene's camera from every mesh it draws.
+	// Call this once the scene's meshes are loaded.
+	void build_collision(){
+		if(collider)
+			delete collider;
+
+		collider = new Collider(drawable_meshes);
+		cam->collider = collider;
+	}
+
+	// Replace every non-dynamic mesh in drawable_meshes with one merged
+	// mesh. Call this once the scene's meshes are loaded. The original
+	// meshes are still owned by the caller, but are no longer drawn, so
+	// changes to them after this point won't be seen.
+	void batch_static(){
+		list<Mesh*> statics;
+
+		for(auto it = drawable_meshes.begin(); it != drawable_meshes.end();){
+			if(*it && !(*it)->dynamic){
+				statics.push_back(*it);
+				it = drawable_meshes.erase(it);
+			} else it++;
+		}
+
+		if(statics.empty())
+			return;
+
+		if(static_batch)
+			statics.push_front(static_batch);
+
+		Mesh *batch = Mesh::merge(cam, statics);
+
+		if(static_batch)
+			delete static_batch;
+
+		static_batch = batch;
+		drawable_meshes.push_front(static_batch);
+	}
+
+	// Draw every transparent face of every mesh, sorted far to near. Faces
+	// are bucketed by the distance to their centroid, and each bucket is
+	// kept in order with an insertion sort, which is cheap since buckets are
+	// small.
+	void draw_transparent(){
+		struct sorted_face {
+			double distance;
+			Mesh *mesh;
+			Mesh::Face *face;
+		};
+
+		static vector<sorted_face> buckets[ALPHA_SORT_BUCKETS];
+		int bucket_min = ALPHA_SORT_BUCKETS, bucket_max = -1;
+
+		for(Mesh *mesh : meshes_drawn){
+			for(Mesh::Face &face : mesh->faces){
+				if(!face.transparent() || !face.fill[3])
+					continue;
+
+				double distance = cam->pos.distance_to(face.centroid());
+				int b = (int)(distance / MAX_DRAW_DISTANCE * ALPHA_SORT_BUCKETS);
+
+				if(b >= ALPHA_SORT_BUCKETS)
+					b = ALPHA_SORT_BUCKETS - 1;
+
+				vector<sorted_face> &bucket = buckets[b];
+				bucket.push_back((sorted_face){ distance, mesh, &face });
+
+				for(int i = bucket.size() - 1; (i > 0) && (bucket[i - 1].distance < distance); i--)
+					swap(bucket[i], bucket[i - 1]);
+
+				if(b < bucket_min)
+					bucket_min = b;
+				if(b > bucket_max)
+					bucket_max = b;
+			}
+		}
+
+		for(int b = bucket_max; b >= bucket_min; b--){
+			for(sorted_face &sf : buckets[b])
+				sf.mesh->draw_face_blended(*sf.face);
+
+			buckets[b].clear();
+		}
+	}
+
+	// Color every pixel of the visibility buffer from the face that won it.
+	// Texture coordinates come from the pixel's point in the world, rebuilt
+	// from its view angle and depth, and mapped into the face through the
+	// barycentric coordinates of its first three vertices. Pixels in a row
+	// are mostly runs of the same face, so the per-face setup is only redone
+	// when the id changes.
+	void resolve_visibility(){
+		const byte_t black[4] = { 0x00, 0x00, 0x00, 0xff };
+		const byte_t black_ix = (cam->indexed ? Camera::quantize(black) : 0);
+		const int w = cam->w, h = cam->h;
+
+		// Direction of each column and row, from the inverse of
+		// Camera::vertex_screenspace.
+		static vector<double> col_cos, col_sin, row_cos, row_sin;
+		col_cos.resize(w);
+		col_sin.resize(w);
+		row_cos.resize(h);
+		row_sin.resize(h);
+
+		for(int x = 0; x < w; x++){
+			double a = cam->point_xz.getValue() + ((w / 2.0) - x) * 2 * cam->maxangle_w / w;
+
+			col_cos[x] = cos(a);
+			col_sin[x] = sin(a);
+		}
+		for(int y = 0; y < h; y++){
+			double a = cam->point_y.getValue() + ((h / 2.0) - y) * 2 * cam->maxangle_h / h;
+
+			row_cos[y] = cos(a);
+			row_sin[y] = sin(a);
+		}
+
+		for(int y = 0; y < h; y++){
+			uint64_t last = 0;
+			const Mesh::Face *face = NULL;
+			coord v0 = { 0, 0, 0 }, e1 = { 0, 0, 0 }, e2 = { 0, 0, 0 };
+			double d00 = 0, d01 = 0, d11 = 0, inv = 0;
+			double u_prev = 0, v_prev = 0;
+			int level = 0;
+			byte_t fill_ix = 0;
+
+			for(int x = 0; x < w; x++){
+				const int offset = (w * y + x);
+				const uint64_t id = cam->screenspace_id[offset];
+
+				if(!id){
+					last = 0;
+					continue;
+				}
+
+				bool run = (id == last);
+
+				if(!run){
+					last = id;
+					face = NULL;
+
+					if((id & VIS_FACE_MASK) != VIS_FACE_EDGE){
+						Mesh *mesh = vis_meshes[(id >> VIS_FACE_BITS) - 1];
+
+						face = &mesh->faces[id & VIS_FACE_MASK];
+
+						if(cam->indexed)
+							fill_ix = Camera::quantize(face->fill);
+
+						if(face->tex){
+							v0 = mesh->vertex(face->vertIds[0]);
+							e1 = mesh->vertex(face->vertIds[1]) - v0;
+							e2 = mesh->vertex(face->vertIds[2]) - v0;
+							d00 = e1.x * e1.x + e1.y * e1.y + e1.z * e1.z;
+							d01 = e1.x * e2.x + e1.y * e2.y + e1.z * e2.z;
+							d11 = e2.x * e2.x + e2.y * e2.y + e2.z * e2.z;
+							inv = d00 * d11 - d01 * d01;
+							inv = (inv ? (1.0 / inv) : 0);
+						}
+					}
+				}
+
+				if(!face){
+					if(cam->indexed)
+						cam->screenspace_ix[offset] = black_ix;
+					else
+						memcpy(&cam->screenspace_px[offset * 4], black, 4);
+
+					continue;
+				}
+
+				if(!face->tex){
+					if(cam->indexed)
+						cam->screenspace_ix[offset] = fill_ix;
+					else
+						memcpy(&cam->screenspace_px[offset * 4], face->fill, 4);
+
+					continue;
+				}
+
+				const double depth = cam->screenspace_zb[offset];
+				const coord d = (coord){
+					cam->pos.x + row_cos[y] * col_cos[x] * depth,
+					cam->pos.y + row_sin[y] * depth,
+					cam->pos.z + row_cos[y] * col_sin[x] * depth
+				} - v0;
+				const double d20 = d.x * e1.x + d.y * e1.y + d.z * e1.z;
+				const double d21 = d.x * e2.x + d.y * e2.y + d.z * e2.z;
+				const double b1 = (d11 * d20 - d01 * d21) * inv;
+				const double b2 = (d00 * d21 - d01 * d20) * inv;
+				const double *uvs = &face->uvs[0];
+				const double u = uvs[0] + (uvs[2] - uvs[0]) * b1 + (uvs[4] - uvs[0]) * b2;
+				const double v = uvs[1] + (uvs[3] - uvs[1]) * b1 + (uvs[5] - uvs[1]) * b2;
+
+				// The step from the last pixel of the run picks the mip level.
+				if(run)
+					level = face->tex->level_for(u - u_prev, v - v_prev);
+				else
+					level = 0;
+
+				u_prev = u;
+				v_prev = v;
+
+				uint32_t texel = face->tex->sample(level, u, v);
+
+				if(cam->indexed)
+					cam->screenspace_ix[offset] = Camera::quantize(texel);
+				else
+					memcpy(&cam->screenspace_px[offset * 4], &texel, 4);
+			}
+		}
+	}
+
+	// The mesh and face drawn at a pixel of the last frame, from the
+	// visibility buffer. Returns NULL if the camera isn't deferred, or if
+	// nothing was drawn there. Face borders give the mesh but no face.
+	Mesh::Face *pick(const int &x, const int &y, Mesh **mesh = NULL){
+		if(mesh)
+			*mesh = NULL;
+
+		if(!cam->deferred || (x < 0) || (x >= cam->w) || (y < 0) || (y >= cam->h))
+			return NULL;
+
+		const uint64_t id = cam->screenspace_id[cam->w * y + x];
+		const size_t slot = (id >> VIS_FACE_BITS);
+
+		if(!id || (slot > vis_meshes.size()))
+			return NULL;
+
+		if(mesh)
+			*mesh = vis_meshes[slot - 1];
+
+		if((id & VIS_FACE_MASK) == VIS_FACE_EDGE)
+			return NULL;
+
+		return &vis_meshes[slot - 1]->faces[id & VIS_FACE_MASK];
+	}
+
+	// Draw a mesh with full geometry, noting it for the passes which follow.
+	void draw_mesh(Mesh *mesh, int ticks){
+		if(cam->deferred){
+			vis_meshes.push_back(mesh);
+			mesh->vis_id = ((uint64_t) vis_meshes.size() << VIS_FACE_BITS);
+		}
+
+		mesh->draw(ticks);
+		meshes_drawn.push_back(mesh);
+	}
+
+	virtual void draw(int ticks){
 		// Update camera's cached math results.
 		cam->cache();
 
 		// Draw each mesh. The order doesn't matter because the draw function
 		// has a z-buffer.
-		for(Mesh *mesh : drawable_meshes)
-			mesh->draw(ticks);
+		meshes_drawn.clear();
+		vis_meshes.clear();
+		for(Mesh *mesh : drawable_meshes){
+			if(impostor_distance && !cam->wireframe && ((cam->pos.distance_to(mesh->bound_center) - mesh->bound_radius) > impostor_distance)){
+				Impostor *&impostor = impostors[mesh];
+
+				if(!impostor)
+					impostor = new Impostor(mesh);
+
+				if(impostor->usable()){
+					impostor->draw();
+					continue;
+				}
+			}
+
+			draw_mesh(mesh, ticks);
+		}
+
+		if(world){
+			world->update();
+
+			world_chunks.clear();
+			world->select(world_chunks);
+
+			for(Mesh *chunk : world_chunks)
+				draw_mesh(chunk, ticks);
+		}
+
+		if(terrain){
+			terrain_chunks.clear();
+			terrain->select(terrain_chunks);
+
+			for(Mesh *chunk : terrain_chunks)
+				draw_mesh(chunk, ticks);
+		}
+
+		if(cam->deferred)
+			resolve_visibility();
+
+		for(Renderable *effect : effects)
+			effect->draw(ticks);
+
+		// Blend transparent faces over the opaque scene.
+		if(!cam->wireframe)
+			draw_transparent();
 
 		// Copy the frame buffer to the screen.
 		cam->draw_frame();
@@ -721,3 +3300,18 @@ protected:
 	Scene3D(Controller *ctrl) : Scene(ctrl) {}
 
 };
+
+map<string, Scene3D::Texture*> Scene3D::Texture::textures;
+SDL_mutex *Scene3D::Texture::textures_lock = SDL_CreateMutex();
+Scene3D::pixel Scene3D::Mesh::scanlines[SCREEN_HEIGHT];
+Scene3D::coord Scene3D::Mesh::scanlines_coords[SCREEN_HEIGHT * 2];
+Scene3D::Mesh::uvw Scene3D::Mesh::scanlines_uvw[SCREEN_HEIGHT * 2];
+vector<Scene3D::coord> Scene3D::Mesh::unpacked;
+int Scene3D::Mesh::y_min = 0;
+int Scene3D::Mesh::y_max = SCREEN_HEIGHT - 1;
+map<string, MeshData*> Scene3D::Mesh::parsed;
+SDL_mutex *Scene3D::Mesh::parsed_lock = SDL_CreateMutex();
+uint32_t Scene3D::Camera::palette[256];
+byte_t Scene3D::Camera::palette_lookup[1 << 15];
+bool Scene3D::Camera::palette_lookup_ready = false;
+bool Scene3D::Camera::palette_custom = false;
@@ -10,7 +10,7 @@ class CardsScene : public Scene {
 public:
 	CardsScene(Scene::Controller *ctrl) : Scene(ctrl) {
 		// FIXME debug - change this image to a playing card table.
-		bg = textureFromBmp(rend, "pict0007.bmp");
+		bg = textureFromBmp(rend, asset::pict0007_bmp);
 
 		PlayingCard::Suit suits[4] = {
 			PlayingCard::Suit::A,
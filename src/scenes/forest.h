@@ -21,7 +21,7 @@ class ForestScene : public Scene {
 		}
 
 		void action(){
-			ctrl->set_scene(Scene::create(ctrl, "test3d"));
+			ctrl->set_scene("test3d");
 		}
 	} *playButton;
 
@@ -45,7 +45,7 @@ class ForestScene : public Scene {
 
 public:
 	ForestScene(Scene::Controller *ctrl) : Scene(ctrl) {
-		forest = textureFromBmp(rend, "pict0007.bmp");
+		forest = textureFromBmp(rend, asset::pict0007_bmp);
 		pan = (SDL_Rect){
 			0, 0,
 			SCREEN_WIDTH, SCREEN_HEIGHT
@@ -73,14 +73,14 @@ public:
 			5, 0,
 			SCREEN_WIDTH, SCREEN_HEIGHT
 		}, "Pico Gamo");
-		title->set_font("fonts/24x28.bmp", 24, 28);
+		title->set_font(asset::fonts_24x28_bmp, 24, 28);
 		title->set_color(0x90, 0x00, 0x00);
 		title->set_alpha(0x00);
 		drawables.push_back(title);
 
 		// Load and start background music.
 		{
-			FileLoader *fl = FileLoader::get("t2.wav");
+			FileLoader *fl = FileLoader::get(asset::t2_wav);
 
 			if(fl){
 				music = fl->music();
@@ -96,13 +96,16 @@ public:
 
 		drawables.push_back(card_panel);
 		clickables.push_back(card_panel);
+
+		// Parse the 3D scene's meshes while the title is up.
+		Scene::preload("test3d");
 	}
 
 	~ForestScene(){
 		if(Mix_PlayingMusic())
 			Mix_HaltMusic();
 
-		SDL_DestroyTexture(forest);
+		textureRelease(forest);
 
 		delete playButton;
 		delete quitButton;
@@ -8,7 +8,7 @@ class GarageScene : public Scene {
 		}
 
 		void action(){
-			ctrl->set_scene(Scene::create(ctrl, "living"));
+			ctrl->set_scene("living");
 		}
 
 	} *livingRoomButton;
@@ -17,7 +17,7 @@ class GarageScene : public Scene {
 
 public:
 	GarageScene(Scene::Controller *ctrl) : Scene(ctrl) {
-		bg = textureFromBmp(rend, "garage.bmp");
+		bg = textureFromBmp(rend, asset::garage_bmp);
 
 		livingRoomButton = new LivingRoomButton(ctrl, rend, SCREEN_WIDTH - 90, 10, "Living Room");
 		drawables.push_back(livingRoomButton);
@@ -4,7 +4,7 @@ class IntroSplashScene : public Scene {
 	int ticks_tocreditshow   = 1200;
 	int ticks_tocreditchange = 1800;
 
-	PicoText *text_credit_me;
+	PicoText *text_credit_me, *text_loading;
 
 	class KrakCircle :
 		public Drawable,
@@ -17,12 +17,12 @@ class IntroSplashScene : public Scene {
 			Drawable(rend),
 			Movable(0, 0)
 		{
-			krakcircle = textureFromBmp(rend, "krakcircle.bmp", true);
+			krakcircle = textureFromBmp(rend, asset::krakcircle_bmp, true);
 			movable_time = 1000;
 		}
 
 		~KrakCircle(){
-			SDL_DestroyTexture(krakcircle);
+			textureRelease(krakcircle);
 		}
 
 		void draw(int ticks){
@@ -55,21 +55,32 @@ public:
 		text_credit_me->set_color(0x61, 0x34, 0x80);
 		drawables.push_back(text_credit_me);
 
+		text_loading = new PicoText(rend, (SDL_Rect){
+			5, SCREEN_HEIGHT - 10,
+			SCREEN_WIDTH, 10
+		}, "");
+		text_loading->set_color(0x61, 0x34, 0x80);
+		drawables.push_back(text_loading);
+
 		// Immediately play stinger sound.
 		try {
-			Mix_PlayChannel(-1, FileLoader::get("sound/stinger.wav")->sound(), 0);
+			Mix_PlayChannel(-1, FileLoader::get(asset::sound_stinger_wav)->sound(), 0);
 		} catch(...){
 			cout << "Failed to find file: stinger.wav" << endl;
 		}
 
 		drawables.push_back(kc = new KrakCircle(rend));
 
+		// Get the forest's assets ready while the splash plays.
+		Scene::preload("forest");
+
 		// Disable mouse to hide the cursor.
 		ctrl->mouse_enabled = false;
 	}
 
 	~IntroSplashScene(){
 		delete text_credit_me;
+		delete text_loading;
 		delete kc;
 
 		// Show mouse cursor again.
@@ -83,6 +94,10 @@ public:
 		Scene::draw(ticks);
 		ticks_total += ticks;
 
+		int percent = (int)(Scene::preload_progress("forest") * 100);
+
+		text_loading->set_message((percent < 100) ? ("loading " + to_string(percent) + "%") : "");
+
 		// A game by:
 		if((ticks_tocreditshow -= ticks) <= 0){
 			ticks_tocreditshow = 0;
@@ -98,8 +113,8 @@ public:
 			);
 		}
 
-		// Wait about three seconds.
+		// Wait about three seconds. The forest shows up once it's preloaded.
 		if(ticks_total > 2950)
-			ctrl->set_scene(Scene::create(ctrl, "forest"));
+			ctrl->set_scene("forest");
 	}
 };
@@ -4,7 +4,7 @@ private:
 
 public:
 	JeepScene(Scene::Controller *ctrl) : Scene(ctrl) {
-		bg = textureFromBmp(rend, "jeep.bmp");
+		bg = textureFromBmp(rend, asset::jeep_bmp);
 
 		snow = new SnowEffect(
 			rend,
@@ -19,7 +19,7 @@ class LivingRoomScene : public Scene {
 		ChirpButton(SDL_Renderer *rend, SDL_Rect click_region, string text) : Button(rend, click_region, text) {
 			// Load chirp sound.
 			{
-				FileLoader *fl = FileLoader::get("atari.wav");
+				FileLoader *fl = FileLoader::get(asset::atari_wav);
 
 				if(fl){
 					atari = fl->sound();
@@ -46,11 +46,11 @@ class LivingRoomScene : public Scene {
 
 public:
 	LivingRoomScene(Scene::Controller *ctrl) : Scene(ctrl) {
-		bg = textureFromBmp(rend, "living/1.bmp");
+		bg = textureFromBmp(rend, asset::living_1_bmp);
 
 		// Load music.
 		{
-			FileLoader *fl = FileLoader::get("t2.wav");
+			FileLoader *fl = FileLoader::get(asset::t2_wav);
 
 			if(fl){
 				music = fl->music();
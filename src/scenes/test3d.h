@@ -69,25 +69,93 @@ class TestScene3D : public Scene3D {
 
 	list<Scene3D::Mesh*> rendered_meshes;
 
+	SnowEffect3D *snow;
+	Scene3D::Clip *wizard_idle = NULL;
+
 public:
 	TestScene3D(Scene::Controller *ctrl) : Scene3D(ctrl) {
 		cam = new Camera(rend, { -6.7, 1, 4.6 }, { 1, 0, -1 }, SCREEN_WIDTH, SCREEN_HEIGHT, 0.46 /* approximately 90 degrees horizontal FOV */);
 		clickables.push_back(cam);
 
+		// Anything this far away can be drawn as a sprite.
+		impostor_distance = 40;
+
+		// Retro post-processing, off until toggled.
+		cam->post.add(new FogPass(0xad, 0x29, 0x10, 10, 60, 0.8f));
+		cam->post.add(new GradePass(1.1f, 1.0f, 0.9f));
+		cam->post.add(new ScanlinePass());
+		cam->post.add(new DitherPass());
+		cam->post.set_enabled(false);
+
 		{
-			Mesh *mesh = Scene3D::Mesh::load(cam, "models/test_room.mesh");
+			Mesh *mesh = Scene3D::Mesh::load(cam, asset::models_test_room_mesh);
 
 			drawable_meshes.push_back(mesh);
 			rendered_meshes.push_back(mesh);
 		}
 
 		{
-			Mesh *mesh = Scene3D::Mesh::load(cam, "models/wizard.mesh");
+			Mesh *mesh = Scene3D::Mesh::load(cam, asset::models_wizard_mesh);
+
+			// The wizard idles in place, so keep it out of the static batch.
+			if(mesh && (wizard_idle = Scene3D::Clip::load(asset::models_wizard_anim, mesh)))
+				mesh->play(wizard_idle);
 
 			drawable_meshes.push_back(mesh);
 			rendered_meshes.push_back(mesh);
 		}
 
+		// Draw all of the static geometry in one go, from 16-bit positions.
+		batch_static();
+		if(static_batch)
+			static_batch->quantize();
+
+		// Keep the camera from walking through walls.
+		build_collision();
+
+		// Rolling hills around the room, flat in the middle so they stay
+		// under its floor.
+		{
+			const int n = 65;
+			vector<float> heights(n * n);
+
+			for(int z = 0; z < n; z++){
+				for(int x = 0; x < n; x++){
+					double dx = (x - n / 2) / (n / 2.0), dz = (z - n / 2) / (n / 2.0);
+					double rim = min(1.0, max(0.0, (sqrt(dx * dx + dz * dz) - 0.25) / 0.5));
+
+					heights[z * n + x] = rim * (0.5 + 0.25 * sin(x * 0.4) + 0.25 * cos(z * 0.3));
+				}
+			}
+
+			terrain = new Terrain(cam, heights, n, n, (coord){ -80, -2, -80 }, 160, 12);
+		}
+
+		// Copies of the room out in the hills, one in each region around the
+		// middle four, streamed in as the camera comes near. The budget is
+		// small, so regions left behind are dropped again.
+		{
+			stringstream regions;
+
+			regions << "cell 32" << endl;
+			for(int x = -2; x < 2; x++){
+				for(int z = -2; z < 2; z++){
+					if((x >= -1) && (x < 1) && (z >= -1) && (z < 1))
+						continue;
+
+					coord at = { (x + 0.5) * 32, 0, (z + 0.5) * 32 };
+					at.y = terrain->height_at(at.x, at.z) + 2;
+
+					regions << x << " " << z << " " << FileLoader::name(asset::models_test_room_mesh) << " " << at.x << " " << at.y << " " << at.z << endl;
+				}
+			}
+
+			world = new World(cam, regions, 48, 2 << 20);
+		}
+
+		snow = new SnowEffect3D(cam, (coord){ -20, -1, -20 }, (coord){ 20, 8, 20 }, 20000, 0.3f, 0.1f);
+		effects.push_back(snow);
+
 		text_xyz = new PicoText(rend, (SDL_Rect){
 			5, SCREEN_HEIGHT - 20,
 			SCREEN_WIDTH, 10
@@ -194,6 +262,42 @@ public:
 			} else toggle_wireframe = false;
 		}
 
+		// Toggle the indexed color frame buffer.
+		{
+			static bool toggle_indexed = false;
+
+			if(ctrl->keystate(SDLK_p)){
+				if(!toggle_indexed){
+					toggle_indexed = true;
+					cam->set_indexed(!cam->indexed);
+				}
+			} else toggle_indexed = false;
+		}
+
+		// Toggle deferred shading through the visibility buffer.
+		{
+			static bool toggle_deferred = false;
+
+			if(ctrl->keystate(SDLK_g)){
+				if(!toggle_deferred){
+					toggle_deferred = true;
+					cam->set_deferred(!cam->deferred);
+				}
+			} else toggle_deferred = false;
+		}
+
+		// Toggle the post-processing chain.
+		{
+			static bool toggle_post = false;
+
+			if(ctrl->keystate(SDLK_c)){
+				if(!toggle_post){
+					toggle_post = true;
+					cam->post.set_enabled(cam->post.empty());
+				}
+			} else toggle_post = false;
+		}
+
 		/* on-screen debug */
 		stringstream pry;
 		Scene3D::Radian
@@ -226,6 +330,15 @@ public:
 		for(Scene3D::Mesh *mesh : rendered_meshes)
 			delete mesh;
 
+		delete snow;
+
+		if(wizard_idle)
+			delete wizard_idle;
+
+		// The world's loader builds meshes for the camera, so stop it first.
+		delete world;
+		world = NULL;
+
 		delete cam;
 	}
 };
@@ -0,0 +1,66 @@
+/*
+	SnowEffect3D
+	mperron (2020)
+
+	Snow falling through a box in a Scene3D's world. Flakes which fall out
+	of the bottom of the box start again at the top, and flakes blown out of
+	a side come back in on the other side.
+*/
+class SnowEffect3D : public ParticleEffect3D {
+	Scene3D::coord lo, hi;
+	float wind_x, wind_z;
+
+	static float random(const float &from, const float &to){
+		return from + (rand() % 10000) / 10000.0f * (to - from);
+	}
+
+	void reset(const int &i, const bool &randomY){
+		pos_x[i] = random(lo.x, hi.x);
+		pos_y[i] = (randomY ? random(lo.y, hi.y) : hi.y);
+		pos_z[i] = random(lo.z, hi.z);
+
+		vel_x[i] = wind_x + random(-0.2f, 0.2f);
+		vel_y[i] = -random(0.6f, 1.4f);
+		vel_z[i] = wind_z + random(-0.2f, 0.2f);
+
+		byte_t lum = 0xb0 + (rand() % 0x50);
+		set_color(i, 0xff000000 | (lum << 16) | (lum << 8) | lum);
+	}
+
+public:
+	SnowEffect3D(Scene3D::Camera *cam, const Scene3D::coord &lo, const Scene3D::coord &hi, const int &count, const float &wind_x = 0, const float &wind_z = 0) :
+		ParticleEffect3D(cam, count, 0.03f)
+	{
+		this->lo = lo;
+		this->hi = hi;
+		this->wind_x = wind_x;
+		this->wind_z = wind_z;
+
+		for(int i = 0; i < count; i++)
+			reset(i, true);
+	}
+
+	void update(float time){
+		const int count = pos_x.size();
+		const float span_x = hi.x - lo.x, span_z = hi.z - lo.z;
+
+		integrate(time);
+
+		for(int i = 0; i < count; i++){
+			if(pos_y[i] < lo.y){
+				reset(i, false);
+				continue;
+			}
+
+			if(pos_x[i] < lo.x)
+				pos_x[i] += span_x;
+			else if(pos_x[i] > hi.x)
+				pos_x[i] -= span_x;
+
+			if(pos_z[i] < lo.z)
+				pos_z[i] += span_z;
+			else if(pos_z[i] > hi.z)
+				pos_z[i] -= span_z;
+		}
+	}
+};
@@ -7,7 +7,7 @@
 class PicoText :
 	public Drawable
 {
-	SDL_Texture *font, *font_shadow;
+	TextureRef *font, *font_shadow;
 	SDL_Rect region;
 	string message;
 
@@ -38,13 +38,13 @@ public:
 		this->message = message;
 
 		// Load the default font image.
-		font = textureFromBmp(rend, "fonts/6x7.bmp", true);
-		font_shadow = textureFromBmp(rend, "fonts/6x7.bmp", true);
+		font = new TextureRef(rend, asset::fonts_6x7_bmp, true);
+		font_shadow = new TextureRef(rend, asset::fonts_6x7_bmp, true);
 	}
 
 	~PicoText(){
-		SDL_DestroyTexture(font);
-		SDL_DestroyTexture(font_shadow);
+		delete font;
+		delete font_shadow;
 	}
 
 	void set_shadow(int x, int y){
@@ -52,12 +52,15 @@ public:
 		shadow_offset_y = y;
 	}
 
+	void set_font(asset::id bitmap, int c_width, int c_height){
+		set_font(FileLoader::name(bitmap), c_width, c_height);
+	}
 	void set_font(string bitmap, int c_width, int c_height){
-		SDL_DestroyTexture(font);
-		SDL_DestroyTexture(font_shadow);
+		delete font;
+		delete font_shadow;
 
-		font = textureFromBmp(rend, bitmap.c_str(), true);
-		font_shadow = textureFromBmp(rend, bitmap.c_str(), true);
+		font = new TextureRef(rend, bitmap.c_str(), true);
+		font_shadow = new TextureRef(rend, bitmap.c_str(), true);
 
 		this->c_width = c_width;
 		this->c_height = c_height;
@@ -156,10 +159,10 @@ public:
 					dst.w + shadow_offset_x, dst.h + shadow_offset_y
 				};
 
-				SDL_RenderCopy(rend, font_shadow, &src, &dst_shadow);
+				font_shadow->copy(rend, &src, &dst_shadow);
 			}
 
-			SDL_RenderCopy(rend, font, &src, &dst);
+			font->copy(rend, &src, &dst);
 
 			dst.x += c_width;
 			chars_thisline++;
@@ -180,7 +183,7 @@ public:
 
 	// Set the color of the text at any time.
 	void set_color(char r, char g, char b, bool shadow = false){
-		SDL_SetTextureColorMod((shadow ? font_shadow : font), r, g, b);
+		(shadow ? font_shadow : font)->set_color(r, g, b);
 	}
 	void set_color(SDL_Color col, bool shadow = false){
 		set_color(col.r, col.g, col.b, shadow);
@@ -188,7 +191,7 @@ public:
 
 	// Set the alpha/transparency for the text at any time.
 	void set_alpha(char a, bool shadow = false){
-		SDL_SetTextureAlphaMod((shadow ? font_shadow : font), a);
+		(shadow ? font_shadow : font)->set_alpha(a);
 	}
 
 	void set_blink(unsigned int on, unsigned int off){
@@ -10,20 +10,163 @@ bool operator != (const SDL_Color &a, const SDL_Color &b){
 	);
 }
 
+// Textures made from bitmaps are shared, one per renderer, file and color
+// key setting, and counted so the last release destroys them.
+struct CachedTexture {
+	SDL_Texture *tx;
+	int refs;
+};
+typedef pair<SDL_Renderer*, pair<string, bool> > texture_key;
+
+map<texture_key, CachedTexture> texture_cache;
+map<SDL_Texture*, texture_key> texture_keys;
+
+// Get the shared texture for a bitmap, with magenta transparent if trans.
+// Release it with textureRelease rather than destroying it.
 SDL_Texture *textureFromBmp(SDL_Renderer *rend, const char *fn, bool trans = false){
+	texture_key key = make_pair(rend, make_pair(string(fn), trans));
+	auto it = texture_cache.find(key);
+
+	if(it != texture_cache.end()){
+		it->second.refs++;
+		return it->second.tx;
+	}
+
 	FileLoader *fl = FileLoader::get(fn);
 	if(!fl)
 		return NULL;
 
 	SDL_Surface *sf = fl->surface();
-	if(sf && trans)
+	if(!sf)
+		return NULL;
+
+	if(trans)
 		SDL_SetColorKey(sf, SDL_TRUE, SDL_MapRGB(sf->format, 0xff, 0x00, 0xff));
+	else
+		SDL_SetColorKey(sf, SDL_FALSE, 0);
 
 	SDL_Texture *tx = SDL_CreateTextureFromSurface(rend, sf);
 
+	if(tx){
+		texture_cache[key] = (CachedTexture){ tx, 1 };
+		texture_keys[tx] = key;
+	}
+
 	return tx;
 }
 
+SDL_Texture *textureFromBmp(SDL_Renderer *rend, asset::id id, bool trans = false){
+	return textureFromBmp(rend, FileLoader::name(id), trans);
+}
+
+void textureRelease(SDL_Texture *tx){
+	auto it = texture_keys.find(tx);
+
+	if(it == texture_keys.end())
+		return;
+
+	if(--texture_cache[it->second].refs <= 0){
+		texture_cache.erase(it->second);
+		texture_keys.erase(it);
+		SDL_DestroyTexture(tx);
+	}
+}
+
+// Where atlaspack put a small bitmap: the atlas/N.bmp page, and a rect.
+struct AtlasRegion {
+	const char *name;
+	int page;
+	SDL_Rect rect;
+};
+
+// Generated by atlaspack, ending with a NULL name.
+extern const AtlasRegion atlas_regions[];
+
+const AtlasRegion *atlas_find(const char *fn){
+	static map<string, const AtlasRegion*> regions;
+
+	if(regions.empty())
+		for(const AtlasRegion *r = atlas_regions; r->name; r++)
+			regions[r->name] = r;
+
+	auto it = regions.find(fn);
+
+	return ((it == regions.end()) ? NULL : it->second);
+}
+
+// The asset name of the page a region is on.
+string atlas_page(const AtlasRegion *region){
+	return "atlas/" + to_string(region->page) + ".bmp";
+}
+
+/*
+	A counted reference to a shared bitmap texture, with its own color and
+	alpha modulation, which is set on the texture whenever it's drawn.
+
+	Color keyed bitmaps which were packed into an atlas are drawn from their
+	region of the atlas page instead, so that everything in the atlas shares
+	one texture and its draws can be batched. Only the pages are embedded,
+	not the bitmaps in them. A bitmap replaced by the asset pack is loaded
+	on its own, since the atlas would be out of date.
+*/
+class TextureRef {
+	SDL_Texture *tx = NULL;
+	SDL_Color mod = { 0xff, 0xff, 0xff, 0xff };
+
+	const AtlasRegion *region = NULL;
+
+public:
+	TextureRef(SDL_Renderer *rend, const char *fn, bool trans = false){
+		if(trans && !FileLoader::in_pack(fn) && (region = atlas_find(fn))){
+			if(!(tx = textureFromBmp(rend, atlas_page(region).c_str(), true)))
+				region = NULL;
+		}
+
+		if(!tx)
+			tx = textureFromBmp(rend, fn, trans);
+	}
+	TextureRef(SDL_Renderer *rend, asset::id id, bool trans = false) :
+		TextureRef(rend, FileLoader::name(id), trans)
+	{}
+	TextureRef(const TextureRef&) = delete;
+
+	~TextureRef(){
+		textureRelease(tx);
+	}
+
+	void set_color(Uint8 r, Uint8 g, Uint8 b){
+		mod.r = r;
+		mod.g = g;
+		mod.b = b;
+	}
+
+	void set_alpha(Uint8 a){
+		mod.a = a;
+	}
+
+	// Draw all or part of the image with this reference's modulation.
+	int copy(SDL_Renderer *rend, const SDL_Rect *src, const SDL_Rect *dst){
+		SDL_Rect from;
+
+		if(!tx)
+			return -1;
+
+		if(region){
+			if(src)
+				from = (SDL_Rect){ region->rect.x + src->x, region->rect.y + src->y, src->w, src->h };
+			else
+				from = region->rect;
+
+			src = &from;
+		}
+
+		SDL_SetTextureColorMod(tx, mod.r, mod.g, mod.b);
+		SDL_SetTextureAlphaMod(tx, mod.a);
+
+		return SDL_RenderCopy(rend, tx, src, dst);
+	}
+};
+
 void rectSum(SDL_Rect &holder, SDL_Rect a, SDL_Rect b){
 	holder.x = (a.x + b.x);
 	holder.y = (a.y + b.y);
@@ -43,6 +43,15 @@ with open(os.path.splitext(bpy.data.filepath)[0] + '.mesh', 'w') as fs:
                     # A nice default blue color.
                     fill = "336699ff"
 
+                # Find the texture image and UV map, if there is one.
+                try:
+                    image = obj.active_material.active_texture.image
+                    texture = 'textures/' + os.path.basename(image.filepath)
+                    uv_layer = obdata.uv_layers.active
+                except Exception as e:
+                    texture = None
+                    uv_layer = None
+
                 # Faces
                 pfs(fs, '\tfaces {\n')
                 for f in obdata.polygons:
@@ -51,7 +60,17 @@ with open(os.path.splitext(bpy.data.filepath)[0] + '.mesh', 'w') as fs:
                     for v in f.vertices:
                         pfs(fs, '{:3d} '.format(v))
 
-                    pfs(fs, '}} {} # Face {:3d}\n'.format(fill, f.index))
+                    # Texture coordinates, with v flipped so that 0 is the top
+                    # row of the image.
+                    uvs = ''
+                    if texture != None and uv_layer != None:
+                        uvs = ' ('
+                        for l in f.loop_indices:
+                            uv = uv_layer.data[l].uv
+                            uvs += ' {:0.4f} {:0.4f}'.format(uv[0], 1.0 - uv[1])
+                        uvs += ' ) @{}'.format(texture)
+
+                    pfs(fs, '}} {}{} # Face {:3d}\n'.format(fill, uvs, f.index))
                 pfs(fs, '\t}\n');
                 pfs(fs, '}\n\n')
         except:
@@ -59,3 +78,64 @@ with open(os.path.splitext(bpy.data.filepath)[0] + '.mesh', 'w') as fs:
 
     # Mark the end of the file.
     pfs(fs, '\nEOF\n');
+
+# Export vertex animation over the scene's frame range as a .anim clip, with
+# each keyframe's offsets from the exported rest pose quantized to 16 bits.
+ANIM_STEP = 2
+
+def mesh_objects():
+    for obj in bpy.data.objects:
+        try:
+            if obj.data != None and obj.data.vertices != None and obj.data.polygons != None:
+                yield obj
+        except:
+            pass
+
+scene = bpy.context.scene
+rest = []
+for obj in mesh_objects():
+    for v in obj.data.vertices:
+        co = obj.matrix_world * v.co
+        rest.append((co.x, co.z, co.y))
+
+frames = []
+current = scene.frame_current
+for frame in range(scene.frame_start, scene.frame_end + 1, ANIM_STEP):
+    scene.frame_set(frame)
+    offsets = []
+
+    for obj in mesh_objects():
+        posed = obj.to_mesh(scene, True, 'PREVIEW')
+
+        # Topology changing modifiers can't be exported as offsets.
+        if len(posed.vertices) != len(obj.data.vertices):
+            posed_coords = [obj.matrix_world * v.co for v in obj.data.vertices]
+        else:
+            posed_coords = [obj.matrix_world * v.co for v in posed.vertices]
+
+        for co in posed_coords:
+            r = rest[len(offsets)]
+            offsets.append((co.x - r[0], co.z - r[1], co.y - r[2]))
+
+        bpy.data.meshes.remove(posed)
+
+    frames.append(offsets)
+scene.frame_set(current)
+
+largest = max([abs(d) for offsets in frames for o in offsets for d in o] + [0])
+if len(frames) > 1 and largest > 0:
+    scale = largest / 32767.0
+
+    with open(os.path.splitext(bpy.data.filepath)[0] + '.anim', 'w') as fs:
+        fs.write('fps {:0.3f}\n'.format(scene.render.fps / float(ANIM_STEP)))
+        fs.write('scale {:0.9f}\n'.format(scale))
+
+        for offsets in frames:
+            fs.write('frame\n')
+            for i, o in enumerate(offsets):
+                fs.write('{{ {:d} {:d} {:d} }} # Vert {:3d}\n'.format(
+                    int(round(o[0] / scale)),
+                    int(round(o[1] / scale)),
+                    int(round(o[2] / scale)),
+                    i
+                ))